@@ -5,309 +5,6854 @@
      Date: May 9, 2025
      Description: This program manages an inventory of products, allowing the user to 
      add items, apply discounts, sell items, restock low inventory, and save inventory 
-     to a file. It supports two product types: Electronics and Food.
+     to a file. It supports Electronics, Food, Apparel and Pharmacy products.
  */
 
 #include <iostream>
 #include <string>
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <fstream>
+#include <sstream>
 #include <algorithm>
 #include <memory>
+#include <new>
+#include <type_traits>
 #include <ctime>
 #include <limits>
 #include <climits>
 #include <cfloat>
 #include <iomanip> 
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <bit>
+#include <shared_mutex>
+#include <cstdint>
+#include <string_view>
+#include <array>
+#include <tuple>
+#include <deque>
+#include <queue>
+#include <functional>
+#include <charconv>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <random>
+#include <filesystem>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX // Keep windows.h from defining min and max macros
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <sys/socket.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <csignal>
+#include <cerrno>
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+#endif
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define INVENTORY_X86_SIMD 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and Clang need per-function target attributes for intrinsics; MSVC does not
+#if defined(INVENTORY_X86_SIMD) && (defined(__GNUC__) || defined(__clang__))
+#define INVENTORY_TARGET(isa) __attribute__((target(isa)))
+#else
+#define INVENTORY_TARGET(isa)
+#endif
+
+// Hint that a cache line will be read soon; a no-op where no intrinsic exists
+#if defined(INVENTORY_X86_SIMD)
+#define INVENTORY_PREFETCH(address) _mm_prefetch(reinterpret_cast<const char*>(address), _MM_HINT_T0)
+#elif defined(__GNUC__) || defined(__clang__)
+#define INVENTORY_PREFETCH(address) __builtin_prefetch(address)
+#else
+#define INVENTORY_PREFETCH(address) ((void)0)
+#endif
+
+// Define INVENTORY_METRICS as 0 to compile the operation metrics out entirely
+#ifndef INVENTORY_METRICS
+#define INVENTORY_METRICS 1
+#endif
 
 using namespace std;
 
+// Product type tag shared by the columnar store and the binary snapshot.
+// Values are stored in files and logs, so new types take the next free value.
+enum class ProductTypeTag : uint8_t { Electronics = 1, Food = 2, Apparel = 3, Pharmacy = 4 };
+
+// How an extra field of a product type is stored. The store columns, the
+// inventory.txt record, the binary snapshot and the write-ahead log carry one
+// integer slot and one text slot per product, so a type may declare at most
+// one Integer field and at most one Text or Date field. A Date is a text
+// field whose day number is also kept for expiry sweeps.
+enum class FieldKind : uint8_t { Integer, Text, Date };
+
+struct ProductField {
+    FieldKind kind;
+    string_view label;  // Display label, e.g. "Warranty Period"
+    string_view suffix; // Printed after the value, e.g. " months"
+    string_view prompt; // Asked for when a product is entered from the menu
+};
+
+// Façade classes, defined with Product
+class Electronics;
+class Food;
+class Apparel;
+class Pharmacy;
+
+/*
+ * Product type declarations.
+ * Each type lists its tag, its name, the façade class that dispatch casts to
+ * and its extra fields in record order. Names, parsing, formatting, display
+ * and dispatch are generated from these by ProductTypeList. The storage is
+ * not: ProductStore, the write-ahead log and the binary snapshot have one
+ * integer column and one text column shared by all types, so a type may
+ * declare at most one Integer field and one Text or Date field (FieldSlots
+ * checks this). Within that limit, adding a type means adding one
+ * declaration here, a façade class and an entry in ProductTypes; a type with
+ * more fields also needs new columns and a new snapshot/WAL format version.
+ */
+struct ElectronicsType {
+    static constexpr ProductTypeTag tag = ProductTypeTag::Electronics;
+    static constexpr string_view name = "Electronics";
+    using Facade = Electronics;
+    static constexpr array<ProductField, 1> fields = { {
+        { FieldKind::Integer, "Warranty Period", " months", "Enter warranty period (months): " },
+    } };
+};
+
+struct FoodType {
+    static constexpr ProductTypeTag tag = ProductTypeTag::Food;
+    static constexpr string_view name = "Food";
+    using Facade = Food;
+    static constexpr array<ProductField, 1> fields = { {
+        { FieldKind::Date, "Expiration Date", "", "Enter expiration date (YYYY-MM-DD): " },
+    } };
+};
+
+struct ApparelType {
+    static constexpr ProductTypeTag tag = ProductTypeTag::Apparel;
+    static constexpr string_view name = "Apparel";
+    using Facade = Apparel;
+    static constexpr array<ProductField, 1> fields = { {
+        { FieldKind::Text, "Size", "", "Enter size: " },
+    } };
+};
+
+struct PharmacyType {
+    static constexpr ProductTypeTag tag = ProductTypeTag::Pharmacy;
+    static constexpr string_view name = "Pharmacy";
+    using Facade = Pharmacy;
+    static constexpr array<ProductField, 2> fields = { {
+        { FieldKind::Integer, "Dosage", " mg", "Enter dosage (mg): " },
+        { FieldKind::Date, "Expiration Date", "", "Enter expiration date (YYYY-MM-DD): " },
+    } };
+};
+
+// Where a type's fields live in the shared integer and text slots
+template <typename Type>
+struct FieldSlots {
+    static constexpr size_t none = SIZE_MAX;
+
+    static constexpr size_t find(bool text) {
+        for (size_t i = 0; i < Type::fields.size(); ++i) {
+            if ((Type::fields[i].kind != FieldKind::Integer) == text) return i;
+        }
+        return none;
+    }
+
+    static constexpr size_t countOf(bool text) {
+        size_t count = 0;
+        for (const ProductField& field : Type::fields) count += (field.kind != FieldKind::Integer) == text;
+        return count;
+    }
+
+    static_assert(countOf(false) <= 1 && countOf(true) <= 1,
+        "A product type has one integer slot and one text slot; declare at most one Integer and one Text or Date field");
+
+    static constexpr size_t integer = find(false); // Index in Type::fields, or none
+    static constexpr size_t text = find(true);
+    static constexpr bool dated = text != none && Type::fields[text].kind == FieldKind::Date;
+};
+
+/*
+ * Compile-time registry over a list of product type declarations.
+ * Tag-indexed tables are sized to a power of two so a lookup is one mask and
+ * one load, and dispatch() expands to a chain of tag compares that the
+ * compiler turns into a switch; nothing is looked up by name or through a
+ * vtable at run time.
+ */
+template <typename... Types>
+struct ProductTypeList {
+    static constexpr size_t count = sizeof...(Types);
+    static constexpr size_t slots = bit_ceil(max({ static_cast<size_t>(Types::tag)... }) + 1);
+    static constexpr size_t mask = slots - 1;
+    static constexpr size_t maxFields = max({ Types::fields.size()... });
+    static constexpr array<ProductTypeTag, count> tags = { Types::tag... };
+
+private:
+    template <typename Value, typename Make>
+    static constexpr array<Value, slots> table(Value fallback, Make make) {
+        array<Value, slots> values{};
+        values.fill(fallback);
+        ((values[static_cast<size_t>(Types::tag)] = make(type_identity<Types>{})), ...);
+        return values;
+    }
+
+    template <size_t I, typename Visitor>
+    static decltype(auto) dispatchFrom(ProductTypeTag tag, Visitor& visit) {
+        using Type = tuple_element_t<I, tuple<Types...>>;
+        if constexpr (I + 1 == count) {
+            return visit(type_identity<Type>{}); // Tags are validated on entry; the last type takes the rest
+        }
+        else {
+            if (tag == Type::tag) return visit(type_identity<Type>{});
+            return dispatchFrom<I + 1>(tag, visit);
+        }
+    }
+
+public:
+    static constexpr array<string_view, slots> names = table<string_view>("Unknown", [](auto type) {
+        return decltype(type)::type::name;
+    });
+    static constexpr array<bool, slots> known = table<bool>(false, [](auto) { return true; });
+    static constexpr array<bool, slots> dated = table<bool>(false, [](auto type) {
+        return FieldSlots<typename decltype(type)::type>::dated;
+    });
+
+    static constexpr string_view name(ProductTypeTag tag) { return names[static_cast<size_t>(tag) & mask]; }
+    static constexpr bool isKnown(uint32_t tag) { return tag < slots && known[tag]; }
+    static constexpr bool hasDate(ProductTypeTag tag) { return dated[static_cast<size_t>(tag) & mask]; }
+
+    // Tag for an exact type name, as written in files and scripts; false if unknown
+    static constexpr bool parse(string_view text, ProductTypeTag& tag) {
+        for (ProductTypeTag candidate : tags) {
+            if (name(candidate) == text) {
+                tag = candidate;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // parse() for menu input, ignoring the case of ASCII letters
+    static bool parseIgnoringCase(string_view text, ProductTypeTag& tag) {
+        auto lower = [](char c) { return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c; };
+        for (ProductTypeTag candidate : tags) {
+            string_view known = name(candidate);
+            if (known.size() == text.size() && equal(known.begin(), known.end(), text.begin(),
+                [&](char a, char b) { return lower(a) == lower(b); })) {
+                tag = candidate;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Call visit(type_identity<Type>{}) for the declaration of `tag`
+    template <typename Visitor>
+    static decltype(auto) dispatch(ProductTypeTag tag, Visitor&& visit) {
+        return dispatchFrom<0>(tag, visit);
+    }
+};
+
+using ProductTypes = ProductTypeList<ElectronicsType, FoodType, ApparelType, PharmacyType>;
+
+// Type name from the registry (no allocation)
+constexpr string_view productTypeName(ProductTypeTag type) {
+    return ProductTypes::name(type);
+}
+
+// How appendTypeFields lays out field values
+enum class FieldStyle : uint8_t {
+    Record, // inventory.txt: "value | " per field
+    Display // Listings: "Label: value<suffix>\n" per field
+};
+
+// Append the fields of one product of `Type` from its integer and text slots
+template <typename Type>
+void appendTypeFields(string& out, int32_t integer, string_view text, FieldStyle style) {
+    char number[16];
+    for (const ProductField& field : Type::fields) {
+        if (style == FieldStyle::Display) {
+            out += field.label;
+            out += ": ";
+        }
+        if (field.kind == FieldKind::Integer) out.append(number, to_chars(number, number + sizeof(number), integer).ptr);
+        else out += text;
+        out += style == FieldStyle::Display ? field.suffix : string_view(" | ");
+        if (style == FieldStyle::Display) out += '\n';
+    }
+}
+
+// appendTypeFields() for a type known only at run time
+inline void appendProductFields(string& out, ProductTypeTag type, int32_t integer, string_view text, FieldStyle style) {
+    ProductTypes::dispatch(type, [&](auto declared) {
+        appendTypeFields<typename decltype(declared)::type>(out, integer, text, style);
+    });
+}
+
+// Sentinel for a missing or malformed date; sorts before every real date
+constexpr int32_t invalidDate = INT32_MIN;
+
+// Days from 1970-01-01 to a proleptic Gregorian calendar date
+constexpr int32_t daysFromCivil(int32_t year, uint32_t month, uint32_t day) {
+    year -= month <= 2;
+    const int32_t era = (year >= 0 ? year : year - 399) / 400;
+    const uint32_t yearOfEra = static_cast<uint32_t>(year - era * 400);
+    const uint32_t dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    const uint32_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + static_cast<int32_t>(dayOfEra) - 719468;
+}
+
+// Parse a "YYYY-MM-DD" date into days since 1970-01-01 (invalidDate if it is
+// malformed or not a real calendar day). Apart from the length check every
+// test is folded into one flag, so there are no data-dependent branches.
+inline int32_t parseDateDays(string_view date) {
+    static constexpr uint8_t monthDays[13] = { 0, 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    if (date.size() != 10) return invalidDate;
+    uint32_t digit[10];
+    for (int i = 0; i < 10; ++i) digit[i] = static_cast<uint32_t>(static_cast<unsigned char>(date[i])) - '0';
+
+    bool ok = (date[4] == '-') & (date[7] == '-');
+    ok &= (digit[0] <= 9) & (digit[1] <= 9) & (digit[2] <= 9) & (digit[3] <= 9)
+        & (digit[5] <= 9) & (digit[6] <= 9) & (digit[8] <= 9) & (digit[9] <= 9);
+    const int32_t year = static_cast<int32_t>((digit[0] * 1000 + digit[1] * 100 + digit[2] * 10 + digit[3]) & 0xFFFF);
+    const uint32_t month = (digit[5] * 10 + digit[6]) & 0xFF;
+    const uint32_t day = (digit[8] * 10 + digit[9]) & 0xFF;
+
+    ok &= month - 1 < 12;
+    const uint32_t safeMonth = month * ok; // Keeps the table lookup in bounds
+    const bool leap = (year % 4 == 0) & ((year % 100 != 0) | (year % 400 == 0));
+    const uint32_t daysInMonth = monthDays[safeMonth] + ((safeMonth == 2) & leap);
+    ok &= day - 1 < daysInMonth;
+    const int32_t days = daysFromCivil(year, safeMonth, day);
+    return ok ? days : invalidDate;
+}
+
+// Today's local calendar date as days since 1970-01-01
+inline int32_t todayDays() {
+    time_t now = time(nullptr);
+    std::tm localTime;
+#ifdef _WIN32
+    localtime_s(&localTime, &now);
+#else
+    localtime_r(&now, &localTime);
+#endif
+    return daysFromCivil(localTime.tm_year + 1900, static_cast<uint32_t>(localTime.tm_mon + 1), static_cast<uint32_t>(localTime.tm_mday));
+}
+
+/*
+ * Low-stock restock kernels.
+ * Each one walks a stock column, adds `amount` to every entry below
+ * `threshold` and appends the affected ids to `restocked`. The AVX2 and
+ * SSE4.1 versions do the compare-and-add 8 or 4 lanes at a time and only
+ * branch when a vector actually contains a low-stock entry.
+ */
+typedef void (*RestockKernel)(int32_t* stock, size_t count, int32_t threshold, int32_t amount, vector<uint32_t>& restocked);
+
+// Portable fallback used on non-x86 targets and CPUs without SSE4.1
+inline void restockBelowScalar(int32_t* stock, size_t count, int32_t threshold, int32_t amount, vector<uint32_t>& restocked) {
+    for (size_t i = 0; i < count; ++i) {
+        if (stock[i] < threshold) {
+            stock[i] += amount;
+            restocked.push_back(static_cast<uint32_t>(i));
+        }
+    }
+}
+
+#ifdef INVENTORY_X86_SIMD
+// Append the ids of the set bits in a lane mask
+inline void appendMaskedIds(unsigned mask, size_t base, vector<uint32_t>& restocked) {
+    while (mask) {
+        unsigned lane = 0;
+        while (!(mask & (1u << lane))) ++lane;
+        restocked.push_back(static_cast<uint32_t>(base + lane));
+        mask &= mask - 1;
+    }
+}
+
+INVENTORY_TARGET("sse4.1")
+inline void restockBelowSse41(int32_t* stock, size_t count, int32_t threshold, int32_t amount, vector<uint32_t>& restocked) {
+    const __m128i limit = _mm_set1_epi32(threshold);
+    const __m128i add = _mm_set1_epi32(amount);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(stock + i));
+        __m128i low = _mm_cmplt_epi32(values, limit);
+        unsigned mask = static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(low)));
+        if (mask) {
+            values = _mm_blendv_epi8(values, _mm_add_epi32(values, add), low);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(stock + i), values);
+            appendMaskedIds(mask, i, restocked);
+        }
+    }
+    for (; i < count; ++i) {
+        if (stock[i] < threshold) {
+            stock[i] += amount;
+            restocked.push_back(static_cast<uint32_t>(i));
+        }
+    }
+}
+
+INVENTORY_TARGET("avx2")
+inline void restockBelowAvx2(int32_t* stock, size_t count, int32_t threshold, int32_t amount, vector<uint32_t>& restocked) {
+    const __m256i limit = _mm256_set1_epi32(threshold);
+    const __m256i add = _mm256_set1_epi32(amount);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i values = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(stock + i));
+        __m256i low = _mm256_cmpgt_epi32(limit, values);
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(low)));
+        if (mask) {
+            values = _mm256_add_epi32(values, _mm256_and_si256(add, low));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(stock + i), values);
+            appendMaskedIds(mask, i, restocked);
+        }
+    }
+    for (; i < count; ++i) {
+        if (stock[i] < threshold) {
+            stock[i] += amount;
+            restocked.push_back(static_cast<uint32_t>(i));
+        }
+    }
+}
+
+// Query the CPU (and, for AVX2, the OS's saved register state) for supported instruction sets
+inline bool cpuSupportsAvx2() {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return false;
+    __cpuid(info, 1);
+    bool osSavesYmm = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && ((_xgetbv(0) & 0x6) == 0x6);
+    __cpuidex(info, 7, 0);
+    return osSavesYmm && (info[1] & (1 << 5));
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+inline bool cpuSupportsSse41() {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 19)) != 0;
+#else
+    return __builtin_cpu_supports("sse4.1");
+#endif
+}
+#endif
+
+// Pick the widest kernel this CPU supports (checked once per process)
+inline RestockKernel selectRestockKernel() {
+#ifdef INVENTORY_X86_SIMD
+    static const RestockKernel kernel = cpuSupportsAvx2() ? restockBelowAvx2
+        : cpuSupportsSse41() ? restockBelowSse41 : restockBelowScalar;
+    return kernel;
+#else
+    return restockBelowScalar;
+#endif
+}
+
+/*
+ * Slab allocator for catalog data.
+ * Product façades and their strings are carved out of large blocks with a bump
+ * pointer, so loading a catalog costs one allocation per slab instead of
+ * several per product. Everything handed out is a non-owning pointer or view
+ * that stays valid until the arena is destroyed, which frees it all at once.
+ */
+class CatalogArena {
+private:
+    struct Cleanup {
+        void* object;
+        void (*destroy)(void*);
+    };
+
+    static constexpr size_t slabSize = 256 * 1024;
+
+    vector<unique_ptr<char[]>> slabs;
+    vector<Cleanup> cleanups; // Objects with non-trivial destructors, in creation order
+    char* cursor = nullptr;
+    char* limit = nullptr;
+    size_t used = 0;
+    size_t reserved = 0;
+
+    static char* alignUp(char* pointer, size_t alignment) {
+        uintptr_t address = reinterpret_cast<uintptr_t>(pointer);
+        return reinterpret_cast<char*>((address + alignment - 1) & ~(uintptr_t(alignment) - 1));
+    }
+
+    // Start a new slab with room for `bytes` (oversized requests get a slab of their own)
+    void grow(size_t bytes) {
+        size_t size = max(slabSize, bytes);
+        slabs.emplace_back(new char[size]);
+        cursor = slabs.back().get();
+        limit = cursor + size;
+        reserved += size;
+    }
+
+public:
+    CatalogArena() = default;
+    CatalogArena(const CatalogArena&) = delete;
+    CatalogArena& operator=(const CatalogArena&) = delete;
+
+    // Run the registered destructors; the slabs are then released together
+    ~CatalogArena() {
+        for (size_t i = cleanups.size(); i-- > 0;) cleanups[i].destroy(cleanups[i].object);
+    }
+
+    // Raw aligned storage (alignment must be a power of two)
+    void* allocate(size_t bytes, size_t alignment = alignof(max_align_t)) {
+        char* start = alignUp(cursor, alignment);
+        if (!cursor || static_cast<size_t>(limit - start) < bytes) {
+            grow(bytes + alignment);
+            start = alignUp(cursor, alignment);
+        }
+        cursor = start + bytes;
+        used += bytes;
+        return start;
+    }
+
+    // Copy a string into the arena and return a view of the copy
+    string_view intern(string_view text) {
+        if (text.empty()) return string_view();
+        char* copy = static_cast<char*>(allocate(text.size(), 1));
+        memcpy(copy, text.data(), text.size());
+        return string_view(copy, text.size());
+    }
+
+    // Construct an object in the arena; it is destroyed along with the arena
+    template <typename T, typename... Args>
+    T* create(Args&&... args) {
+        T* object = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        if constexpr (!is_trivially_destructible_v<T>) {
+            cleanups.push_back(Cleanup{ object, [](void* p) { static_cast<T*>(p)->~T(); } });
+        }
+        return object;
+    }
+
+    // Destroy every object and free every slab; all pointers and views handed
+    // out so far become invalid
+    void clear() {
+        for (size_t i = cleanups.size(); i-- > 0;) cleanups[i].destroy(cleanups[i].object);
+        cleanups.clear();
+        slabs.clear();
+        cursor = limit = nullptr;
+        used = reserved = 0;
+    }
+
+    size_t bytesUsed() const { return used; }
+    size_t bytesReserved() const { return reserved; }
+    size_t slabCount() const { return slabs.size(); }
+};
+
+/*
+ * Running catalog totals kept up to date by ProductStore on every change.
+ * Per product type it tracks the product count, units on hand and stock value,
+ * plus a histogram of stock levels, so dashboard questions never walk the
+ * columns. Counters live in per-thread shards (one cache line group each) so
+ * concurrent sales do not write shared memory; reads merge every shard.
+ */
+class StockAggregates {
+public:
+    static constexpr size_t exactLevels = 64;                // Stock levels 0..63 get a bucket each
+    static constexpr size_t bucketCount = exactLevels + 25;  // Then one bucket per power of two up to INT32_MAX
+
+    struct TypeTotals {
+        int64_t products = 0;
+        int64_t units = 0;
+        double value = 0.0;
+    };
+
+    // A merged copy of every shard
+    struct Summary {
+        TypeTotals byType[ProductTypes::slots]; // Indexed by ProductTypeTag
+        int64_t histogram[bucketCount] = {};    // Products per stock-level bucket
+
+        TypeTotals total() const {
+            TypeTotals sum;
+            for (const TypeTotals& type : byType) {
+                sum.products += type.products;
+                sum.units += type.units;
+                sum.value += type.value;
+            }
+            return sum;
+        }
+
+        // Products with stock below `threshold`. Exact up to exactLevels; above
+        // that the count stops at the last bucket boundary under the threshold.
+        int64_t countBelow(int32_t threshold) const {
+            int64_t count = 0;
+            for (size_t bucket = 0; bucket < bucketCount && bucketLimit(bucket) <= threshold; ++bucket) {
+                count += histogram[bucket];
+            }
+            return count;
+        }
+    };
+
+    // Bucket for a stock level; zero and negative levels share bucket 0
+    static size_t bucketOf(int32_t stock) {
+        if (stock < static_cast<int32_t>(exactLevels)) return stock > 0 ? static_cast<size_t>(stock) : 0;
+        return exactLevels + bit_width(static_cast<uint32_t>(stock)) - 7;
+    }
+
+    // One past the highest stock level a bucket holds
+    static int64_t bucketLimit(size_t bucket) {
+        if (bucket < exactLevels) return static_cast<int64_t>(bucket) + 1;
+        return int64_t(1) << (bucket - exactLevels + 7);
+    }
+
+private:
+    static constexpr size_t shardCount = 64;
+
+    struct alignas(64) Shard {
+        atomic<int64_t> products[ProductTypes::slots];
+        atomic<int64_t> units[ProductTypes::slots];
+        atomic<double> value[ProductTypes::slots];
+        atomic<int64_t> histogram[bucketCount];
+    };
+
+    Shard shards[shardCount];
+
+    // Each thread sticks to one shard, assigned round-robin on first use
+    static size_t threadShard() {
+        static atomic<size_t> nextShard{ 0 };
+        thread_local size_t shard = nextShard.fetch_add(1, memory_order_relaxed) % shardCount;
+        return shard;
+    }
+
+    Shard& local() { return shards[threadShard()]; }
+
+public:
+    // A new row
+    void rowAdded(ProductTypeTag type, int32_t stock, double price) {
+        Shard& shard = local();
+        const size_t t = static_cast<uint8_t>(type) & ProductTypes::mask;
+        shard.products[t].fetch_add(1, memory_order_relaxed);
+        shard.units[t].fetch_add(stock, memory_order_relaxed);
+        shard.value[t].fetch_add(price * stock, memory_order_relaxed);
+        shard.histogram[bucketOf(stock)].fetch_add(1, memory_order_relaxed);
+    }
+
+    // A row's stock went from `before` to `after` at the given price
+    void stockChanged(ProductTypeTag type, double price, int32_t before, int32_t after) {
+        Shard& shard = local();
+        const size_t t = static_cast<uint8_t>(type) & ProductTypes::mask;
+        shard.units[t].fetch_add(static_cast<int64_t>(after) - before, memory_order_relaxed);
+        shard.value[t].fetch_add(price * (static_cast<int64_t>(after) - before), memory_order_relaxed);
+        size_t from = bucketOf(before), to = bucketOf(after);
+        if (from != to) {
+            shard.histogram[from].fetch_sub(1, memory_order_relaxed);
+            shard.histogram[to].fetch_add(1, memory_order_relaxed);
+        }
+    }
+
+    // Stock value of one type changed by `delta` (price updates)
+    void valueChanged(ProductTypeTag type, double delta) {
+        local().value[static_cast<uint8_t>(type) & ProductTypes::mask].fetch_add(delta, memory_order_relaxed);
+    }
+
+    // Merge every shard into one summary
+    Summary summary() const {
+        Summary merged;
+        for (const Shard& shard : shards) {
+            for (size_t t = 0; t < ProductTypes::slots; ++t) {
+                merged.byType[t].products += shard.products[t].load(memory_order_relaxed);
+                merged.byType[t].units += shard.units[t].load(memory_order_relaxed);
+                merged.byType[t].value += shard.value[t].load(memory_order_relaxed);
+            }
+            for (size_t bucket = 0; bucket < bucketCount; ++bucket) {
+                merged.histogram[bucket] += shard.histogram[bucket].load(memory_order_relaxed);
+            }
+        }
+        return merged;
+    }
+
+    // Zero every counter (caller must stop all updates meanwhile)
+    void clear() {
+        for (Shard& shard : shards) {
+            for (size_t t = 0; t < ProductTypes::slots; ++t) {
+                shard.products[t].store(0, memory_order_relaxed);
+                shard.units[t].store(0, memory_order_relaxed);
+                shard.value[t].store(0.0, memory_order_relaxed);
+            }
+            for (atomic<int64_t>& bucket : shard.histogram) bucket.store(0, memory_order_relaxed);
+        }
+    }
+};
+
+// How a product's order quantity is chosen once its stock falls below the reorder point
+enum class ReorderRule : uint8_t {
+    None,   // Never triggered
+    Fixed,  // Order `quantity` units
+    MinMax, // Order up to `quantity` units on hand
+    Demand  // Cover `coverDays` of the recent sales rate, at least `quantity` units
+};
+
+// Per-product replenishment settings
+struct ReplenishmentPolicy {
+    ReorderRule rule = ReorderRule::None;
+    int32_t reorderPoint = 0; // Triggered when stock drops below this
+    int32_t quantity = 0;
+    double coverDays = 0.0;   // Demand only
+
+    // Units to order for a product with `stock` on hand that sells `perDay` units a day
+    int32_t orderQuantity(int32_t stock, double perDay) const {
+        if (rule == ReorderRule::Fixed) return quantity;
+        if (rule == ReorderRule::MinMax) return max(0, quantity - stock);
+        if (rule == ReorderRule::Demand) {
+            double target = reorderPoint + ceil(perDay * coverDays);
+            return max(quantity, static_cast<int32_t>(min(target - stock, double(INT32_MAX / 2))));
+        }
+        return 0;
+    }
+};
+
+/*
+ * Struct-of-arrays product store.
+ * Each attribute lives in its own contiguous column indexed by product id, so
+ * scans such as low-stock checks and valuation reports are linear passes over
+ * packed memory that never touch the Product objects.
+ */
+class ProductStore {
+private:
+    vector<int32_t> stock;
+    vector<double> price;
+    vector<uint8_t> typeTag;        // ProductTypeTag
+    vector<int32_t> integerField;   // The type's Integer field (warranty months, dosage), 0 if it has none
+    vector<int32_t> expiryDate;     // Types with a Date field: days since 1970-01-01, invalidDate otherwise
+    vector<string_view> name;       // Views into the owner's CatalogArena
+    vector<string_view> textField;  // The type's Text or Date field as entered (size, expiration), empty if none
+    StockAggregates aggregates;     // Totals and stock histogram, updated by every mutation below
+    vector<uint64_t> dirty;         // One bit per row changed since the last takeDirty()
+
+    // Replenishment triggers: reorderPoint sits beside stock for the check in
+    // every stock decrement; the rest is only read when a row is replenished
+    vector<int32_t> reorderPoint;   // 0 when the row has no policy
+    vector<ReplenishmentPolicy> policies;
+    vector<uint64_t> restockQueued; // One bit per row waiting in `triggered`
+    mutex triggeredMutex;
+    vector<uint32_t> triggered;     // Rows that fell below their reorder point, in trigger order
+
+    // Exponentially decayed unit sales per row, packed as the tick of the last
+    // update (upper 32 bits) and the decayed count as float bits (lower 32), so
+    // a sale updates it with one CAS on 8 bytes
+    vector<uint64_t> demand;
+
+    // Decayed count of a packed demand word as of `tick`
+    static float decayedDemand(uint64_t packed, uint32_t tick) {
+        const float count = bit_cast<float>(static_cast<uint32_t>(packed));
+        const int32_t age = static_cast<int32_t>(tick - static_cast<uint32_t>(packed >> 32));
+        if (age <= 0) return count; // Same tick (the common case for hot rows) or a racing older clock read
+        if (age >= static_cast<int32_t>(32 * demandHalfLifeTicks)) return 0.0f;
+        return count * exp2f(-static_cast<float>(age) / demandHalfLifeTicks);
+    }
+
+    // Flag a row as changed; the bit is set after the value it covers, and a
+    // row that is already dirty costs only a load
+    void markDirty(uint32_t id) {
+        atomic_ref<uint64_t> word(dirty[id >> 6]);
+        const uint64_t bit = uint64_t(1) << (id & 63);
+        if (!(word.load(memory_order_relaxed) & bit)) word.fetch_or(bit, memory_order_release);
+    }
+
+    // Queue a row whose stock is now below its reorder point, once until it is taken
+    void checkReorderPoint(uint32_t id, int32_t after) {
+        if (after >= reorderPoint[id]) return;
+        atomic_ref<uint64_t> word(restockQueued[id >> 6]);
+        const uint64_t bit = uint64_t(1) << (id & 63);
+        if (word.load(memory_order_relaxed) & bit) return;
+        if (word.fetch_or(bit, memory_order_acq_rel) & bit) return;
+        lock_guard<mutex> lock(triggeredMutex);
+        triggered.push_back(id);
+    }
+
+public:
+    // Demand ticks are 2^30 ns (about 1.07 s); counts halve over about an hour
+    static constexpr uint32_t demandHalfLifeTicks = 3360;
+
+    static uint32_t demandTick(int64_t monotonicNs) {
+        return static_cast<uint32_t>(static_cast<uint64_t>(monotonicNs) >> 30);
+    }
+
+    // Append a row and return its id; the strings must outlive the store
+    uint32_t append(ProductTypeTag type, string_view productName, double pr, int32_t units, int32_t integer, string_view text) {
+        uint32_t id = static_cast<uint32_t>(stock.size());
+        stock.push_back(units);
+        price.push_back(pr);
+        typeTag.push_back(static_cast<uint8_t>(type));
+        integerField.push_back(integer);
+        expiryDate.push_back(ProductTypes::hasDate(type) ? parseDateDays(text) : invalidDate);
+        name.push_back(productName);
+        textField.push_back(text);
+        aggregates.rowAdded(type, units, pr);
+        reorderPoint.push_back(0);
+        policies.emplace_back();
+        demand.push_back(0);
+        if ((id & 63) == 0) {
+            dirty.push_back(0);
+            restockQueued.push_back(0);
+        }
+        markDirty(id);
+        return id;
+    }
+
+    // Remove every row (caller holds the catalog exclusively)
+    void clear() {
+        stock.clear();
+        price.clear();
+        typeTag.clear();
+        integerField.clear();
+        expiryDate.clear();
+        name.clear();
+        textField.clear();
+        aggregates.clear();
+        dirty.clear();
+        reorderPoint.clear();
+        policies.clear();
+        restockQueued.clear();
+        {
+            lock_guard<mutex> lock(triggeredMutex);
+            triggered.clear();
+        }
+        demand.clear();
+    }
+
+    // Preallocate every column for a known number of rows
+    void reserve(size_t count) {
+        stock.reserve(count);
+        price.reserve(count);
+        typeTag.reserve(count);
+        integerField.reserve(count);
+        expiryDate.reserve(count);
+        name.reserve(count);
+        textField.reserve(count);
+        dirty.reserve(count / 64 + 1);
+        reorderPoint.reserve(count);
+        policies.reserve(count);
+        restockQueued.reserve(count / 64 + 1);
+        demand.reserve(count);
+    }
+
+    // Point updates below are atomic so many register threads can work on the
+    // same rows at once; column-wide passes expect the caller to hold the
+    // catalog exclusively.
+
+    // Decrement stock with a CAS loop if enough units are available; never oversells
+    bool trySell(uint32_t id, int32_t quantity) {
+        atomic_ref<int32_t> units(stock[id]);
+        int32_t current = units.load(memory_order_relaxed);
+        do {
+            if (current < quantity) return false;
+        } while (!units.compare_exchange_weak(current, current - quantity, memory_order_acq_rel, memory_order_relaxed));
+        aggregates.stockChanged(getTypeTag(id), getPrice(id), current, current - quantity);
+        markDirty(id);
+        checkReorderPoint(id, current - quantity);
+        return true;
+    }
+
+    void addStock(uint32_t id, int32_t quantity) {
+        int32_t before = atomic_ref<int32_t>(stock[id]).fetch_add(quantity, memory_order_acq_rel);
+        aggregates.stockChanged(getTypeTag(id), getPrice(id), before, before + quantity);
+        markDirty(id);
+        if (quantity < 0) checkReorderPoint(id, before + quantity);
+    }
+
+    // Zero a row's stock and return the units it held
+    int32_t takeAllStock(uint32_t id) {
+        int32_t before = atomic_ref<int32_t>(stock[id]).exchange(0, memory_order_acq_rel);
+        aggregates.stockChanged(getTypeTag(id), getPrice(id), before, 0);
+        markDirty(id);
+        checkReorderPoint(id, 0);
+        return before;
+    }
+
+    // Overwrite a row's stock and price from a saved record (caller holds the catalog exclusively)
+    void setStockAndPrice(uint32_t id, int32_t units, double pr) {
+        aggregates.stockChanged(getTypeTag(id), price[id], stock[id], units);
+        aggregates.valueChanged(getTypeTag(id), (pr - price[id]) * units);
+        stock[id] = units;
+        price[id] = pr;
+        markDirty(id);
+        checkReorderPoint(id, units);
+    }
+
+    // Replace a row's replenishment policy (caller holds the catalog
+    // exclusively); a row already below the new reorder point is queued at once
+    void setPolicy(uint32_t id, const ReplenishmentPolicy& policy) {
+        policies[id] = policy;
+        reorderPoint[id] = policy.rule == ReorderRule::None ? 0 : policy.reorderPoint;
+        checkReorderPoint(id, stock[id]);
+    }
+
+    const ReplenishmentPolicy& getPolicy(uint32_t id) const { return policies[id]; }
+
+    // Hand over the rows queued since the last call, in trigger order, and
+    // clear their queued bits so later drops can queue them again
+    vector<uint32_t> takeTriggered() {
+        vector<uint32_t> ids;
+        {
+            lock_guard<mutex> lock(triggeredMutex);
+            ids.swap(triggered);
+        }
+        for (uint32_t id : ids) {
+            atomic_ref<uint64_t>(restockQueued[id >> 6]).fetch_and(~(uint64_t(1) << (id & 63)), memory_order_acq_rel);
+        }
+        return ids;
+    }
+
+    // Add sold units to a row's decayed demand as of `tick`
+    void recordDemand(uint32_t id, int32_t units, uint32_t tick) {
+        atomic_ref<uint64_t> word(demand[id]);
+        uint64_t current = word.load(memory_order_relaxed);
+        uint64_t next;
+        do {
+            const uint32_t last = static_cast<uint32_t>(current >> 32);
+            const uint32_t stamp = static_cast<int32_t>(tick - last) > 0 ? tick : last;
+            const float count = decayedDemand(current, tick) + static_cast<float>(units);
+            next = (static_cast<uint64_t>(stamp) << 32) | bit_cast<uint32_t>(count);
+        } while (!word.compare_exchange_weak(current, next, memory_order_relaxed));
+    }
+
+    // Decayed units sold as of `tick`: about the units of the last 1.44 half-lives
+    float getDemand(uint32_t id, uint32_t tick) const {
+        return decayedDemand(atomic_ref<uint64_t>(const_cast<uint64_t&>(demand[id])).load(memory_order_relaxed), tick);
+    }
+
+    // Units per day for a decayed count. A steady rate r per tick settles the
+    // count at r * halfLife / ln 2, which this inverts.
+    static double demandRatePerDay(double count) {
+        const double ticksPerDay = 86400e9 / double(1 << 30);
+        return count * 0.6931471805599453 / demandHalfLifeTicks * ticksPerDay;
+    }
+
+    // Recent sales rate of a row in units per day
+    double demandPerDay(uint32_t id, uint32_t tick) const {
+        return demandRatePerDay(getDemand(id, tick));
+    }
+
+    size_t triggeredCount() {
+        lock_guard<mutex> lock(triggeredMutex);
+        return triggered.size();
+    }
+
+    void applyDiscount(uint32_t id, double percentage) {
+        atomic_ref<double> value(price[id]);
+        double current = value.load(memory_order_relaxed);
+        double discounted;
+        do {
+            discounted = current - current * (percentage / 100);
+        } while (!value.compare_exchange_weak(current, discounted, memory_order_acq_rel, memory_order_relaxed));
+        aggregates.valueChanged(getTypeTag(id), (discounted - current) * getStock(id));
+        markDirty(id);
+    }
+
+    // Linear pass: ids whose stock is below the threshold
+    vector<uint32_t> idsBelow(int32_t threshold) const {
+        vector<uint32_t> ids;
+        for (uint32_t id = 0; id < stock.size(); ++id) {
+            if (getStock(id) < threshold) ids.push_back(id);
+        }
+        return ids;
+    }
+
+    // Vectorized pass: add `amount` to every row below the threshold and return the affected ids
+    vector<uint32_t> restockBelow(int32_t threshold, int32_t amount) {
+        return restockBelow(threshold, amount, 0, stock.size());
+    }
+
+    // restockBelow() over rows [first, last) only. Disjoint ranges may run on
+    // different threads at once while the caller holds the catalog exclusively.
+    vector<uint32_t> restockBelow(int32_t threshold, int32_t amount, size_t first, size_t last) {
+        vector<uint32_t> restocked;
+        last = min(last, stock.size());
+        if (first >= last) return restocked;
+        selectRestockKernel()(stock.data() + first, last - first, threshold, amount, restocked);
+        for (uint32_t& id : restocked) {
+            id += static_cast<uint32_t>(first);
+            aggregates.stockChanged(getTypeTag(id), price[id], stock[id] - amount, stock[id]);
+            markDirty(id);
+        }
+        return restocked;
+    }
+
+    // Branch-free pass over the price column: every row the predicate accepts is
+    // scaled by (1 - percentage / 100), the rest by 1.0. Returns the number of rows hit.
+    // When `hitIds` is given, the matching ids are collected as well.
+    template <typename Predicate>
+    size_t discountWhere(Predicate matches, double percentage, vector<uint32_t>* hitIds = nullptr) {
+        const double factor = 1.0 - percentage / 100;
+        size_t hits = 0;
+        double hitValue[ProductTypes::slots] = {}; // Stock value of the matching rows before the discount, per type
+        if (hitIds) {
+            for (size_t id = 0; id < price.size(); ++id) {
+                if (matches(static_cast<uint32_t>(id))) {
+                    hitValue[typeTag[id] & ProductTypes::mask] += price[id] * stock[id];
+                    price[id] *= factor;
+                    dirty[id >> 6] |= uint64_t(1) << (id & 63);
+                    hitIds->push_back(static_cast<uint32_t>(id));
+                    ++hits;
+                }
+            }
+        }
+        else {
+            for (size_t id = 0; id < price.size(); ++id) {
+                bool hit = matches(static_cast<uint32_t>(id));
+                hitValue[typeTag[id] & ProductTypes::mask] += hit ? price[id] * stock[id] : 0.0;
+                price[id] *= hit ? factor : 1.0;
+                dirty[id >> 6] |= uint64_t(hit) << (id & 63);
+                hits += hit;
+            }
+        }
+        for (uint8_t t = 0; t < ProductTypes::slots; ++t) {
+            if (hitValue[t] != 0.0) aggregates.valueChanged(static_cast<ProductTypeTag>(t), hitValue[t] * (factor - 1.0));
+        }
+        return hits;
+    }
+
+    // Discount every row of one product type (compiles to a tag compare and a masked multiply)
+    size_t discountByType(ProductTypeTag type, double percentage) {
+        const uint8_t tag = static_cast<uint8_t>(type);
+        const uint8_t* tags = typeTag.data();
+        return discountWhere([tags, tag](uint32_t id) { return tags[id] == tag; }, percentage);
+    }
+
+    // Linear pass: sum of price * stock over every row
+    double totalValue() const {
+        double total = 0.0;
+        for (uint32_t id = 0; id < stock.size(); ++id) {
+            total += getPrice(id) * getStock(id);
+        }
+        return total;
+    }
+
+    // Clear every dirty bit and return the rows that were set, in id order.
+    // Safe alongside point updates: a change racing the clear is either in the
+    // result or stays flagged for the next call.
+    vector<uint32_t> takeDirty() {
+        vector<uint32_t> ids;
+        for (size_t w = 0; w < dirty.size(); ++w) {
+            atomic_ref<uint64_t> word(dirty[w]);
+            if (word.load(memory_order_relaxed) == 0) continue;
+            for (uint64_t bits = word.exchange(0, memory_order_acq_rel); bits; bits &= bits - 1) {
+                ids.push_back(static_cast<uint32_t>(w * 64 + countr_zero(bits)));
+            }
+        }
+        return ids;
+    }
+
+    // Flag rows again, e.g. after a delta save that failed to reach disk
+    void markDirty(const vector<uint32_t>& ids) {
+        for (uint32_t id : ids) markDirty(id);
+    }
+
+    // Running totals and stock histogram, merged across threads
+    StockAggregates::Summary summary() const {
+        return aggregates.summary();
+    }
+
+    // Rebuild the running totals from the columns (caller holds the catalog
+    // exclusively). Clears the rounding drift of incremental value updates and
+    // any skew from a sale racing a discount of the same row.
+    void recountAggregates() {
+        aggregates.clear();
+        for (uint32_t id = 0; id < stock.size(); ++id) {
+            aggregates.rowAdded(getTypeTag(id), stock[id], price[id]);
+        }
+    }
+
+    int32_t getStock(uint32_t id) const {
+        return atomic_ref<int32_t>(const_cast<int32_t&>(stock[id])).load(memory_order_relaxed);
+    }
+    double getPrice(uint32_t id) const {
+        return atomic_ref<double>(const_cast<double&>(price[id])).load(memory_order_relaxed);
+    }
+    ProductTypeTag getTypeTag(uint32_t id) const { return static_cast<ProductTypeTag>(typeTag[id]); }
+    int32_t getIntegerField(uint32_t id) const { return integerField[id]; }
+    int32_t getExpiryDate(uint32_t id) const { return expiryDate[id]; }
+    string_view getName(uint32_t id) const { return name[id]; }
+    string_view getTextField(uint32_t id) const { return textField[id]; }
+    size_t size() const { return stock.size(); }
+};
+
+/*
+ * Base class for the registered product types (see ProductTypes).
+ * Provides common attributes and methods for all product types. Each object
+ * carries a 1-byte ProductTypeTag, and per-type behavior is dispatched on it
+ * with visitProduct instead of virtual functions.
+ * Adding a product to an InventoryManager copies it into the manager's
+ * ProductStore; the manager then hands out arena-allocated façades whose
+ * accessors read that row instead of their own fields.
+ */
+class Product {
+protected:
+    string productName;
+    double price;
+    int stockQuantity;
+    uint32_t productId = 0;        // Dense id assigned by InventoryManager when the product is added
+    ProductStore* store = nullptr; // Backing columns for façades created by InventoryManager
+    ProductTypeTag typeTag;        // Concrete type, used for dispatch instead of a vtable
+
+    // Constructor to initialize product details (called by the concrete types)
+    Product(ProductTypeTag type, string name, double pr, int stock)
+        : productName(name), price(pr), stockQuantity(stock), typeTag(type) {}
+
+    // Constructor for a façade over an existing store row
+    Product(ProductTypeTag type, ProductStore* backing, uint32_t id)
+        : price(0.0), stockQuantity(0), productId(id), store(backing), typeTag(type) {}
+
+    // Display the fields every product has
+    void displayCommon() const {
+        cout << "Product Name: " << getProductName()
+            << ", Price: $" << getPrice()
+            << ", Stock Quantity: " << getStockQuantity() << endl;
+    }
+
+public:
+    // Display product information, including the fields of the concrete type
+    void displayProduct() const;
+
+    // Apply a percentage discount to the product price
+    void applyDiscount(double percentage) {
+        if (store) store->applyDiscount(productId, percentage);
+        else price -= price * (percentage / 100);
+    }
+
+    // Product type name from the static table (no allocation)
+    string_view getProductType() const { return productTypeName(typeTag); }
+
+    // Compact type tag shared with the columnar store
+    ProductTypeTag getTypeTag() const { return typeTag; }
+
+    // Modify stock by a given quantity (can be positive or negative)
+    void updateStock(int quantity) {
+        if (store) store->addStock(productId, quantity);
+        else stockQuantity += quantity;
+    }
+
+    // Attempt to sell a product if sufficient stock is available
+    bool sellProduct(int quantity) {
+        if (store) return store->trySell(productId, quantity);
+        if (stockQuantity >= quantity) {
+            stockQuantity -= quantity;
+            return true;
+        }
+        return false;
+    }
+
+    // Accessor methods for product information
+    int getStockQuantity() const { return store ? store->getStock(productId) : stockQuantity; }
+    string_view getProductName() const { return store ? store->getName(productId) : string_view(productName); }
+    double getPrice() const { return store ? store->getPrice(productId) : price; }
+    uint32_t getProductId() const { return productId; }
+};
+
+/*
+ * Product of one registered type (see ProductTypes).
+ * Standalone objects keep the type's integer and text slots themselves;
+ * façades read them from their store row. Display comes from the type's
+ * field declarations, so a new type only has to name its constructor
+ * arguments and accessors.
+ */
+template <typename Type>
+class CatalogProduct : public Product {
+private:
+    int32_t integerValue = 0; // The type's Integer field, if it declares one
+    string textValue;         // The type's Text or Date field, if it declares one
+
+protected:
+    CatalogProduct(string name, double pr, int stock, int32_t integer, string text)
+        : Product(Type::tag, move(name), pr, stock), integerValue(integer), textValue(move(text)) {}
+
+    // Constructor for a façade over an existing store row
+    CatalogProduct(ProductStore* backing, uint32_t id) : Product(Type::tag, backing, id) {}
+
+public:
+    using Declaration = Type;
+    static constexpr ProductTypeTag tag = Type::tag;
+
+    // Display product details along with the type's own fields
+    void displayProduct() const {
+        displayCommon();
+        string fields;
+        appendTypeFields<Type>(fields, getIntegerField(), getTextField(), FieldStyle::Display);
+        cout << fields;
+    }
+
+    // Append the type's fields in inventory.txt record layout
+    void appendRecordFields(string& out) const {
+        appendTypeFields<Type>(out, getIntegerField(), getTextField(), FieldStyle::Record);
+    }
+
+    int32_t getIntegerField() const { return store ? store->getIntegerField(productId) : integerValue; }
+    string_view getTextField() const { return store ? store->getTextField(productId) : string_view(textValue); }
+};
+
+// Electronics product with additional warranty info
+class Electronics : public CatalogProduct<ElectronicsType> {
+public:
+    // Constructor to initialize electronics product
+    Electronics(string name, double pr, int stock, int warranty)
+        : CatalogProduct(move(name), pr, stock, warranty, string()) {}
+
+    // Constructor for a façade over an existing store row
+    Electronics(ProductStore* backing, uint32_t id) : CatalogProduct(backing, id) {}
+
+    int getWarrantyPeriod() const { return getIntegerField(); } // Warranty period in months
+};
+
+// Food product with expiration date info
+class Food : public CatalogProduct<FoodType> {
+public:
+    // Constructor to initialize food product
+    Food(string name, double pr, int stock, string expiration)
+        : CatalogProduct(move(name), pr, stock, 0, move(expiration)) {}
+
+    // Constructor for a façade over an existing store row
+    Food(ProductStore* backing, uint32_t id) : CatalogProduct(backing, id) {}
+
+    string_view getExpirationDate() const { return getTextField(); }
+};
+
+// Apparel product with a size label
+class Apparel : public CatalogProduct<ApparelType> {
+public:
+    // Constructor to initialize apparel product
+    Apparel(string name, double pr, int stock, string size)
+        : CatalogProduct(move(name), pr, stock, 0, move(size)) {}
+
+    // Constructor for a façade over an existing store row
+    Apparel(ProductStore* backing, uint32_t id) : CatalogProduct(backing, id) {}
+
+    string_view getSize() const { return getTextField(); }
+};
+
+// Pharmacy product with a dosage and an expiration date
+class Pharmacy : public CatalogProduct<PharmacyType> {
+public:
+    // Constructor to initialize pharmacy product
+    Pharmacy(string name, double pr, int stock, int dosage, string expiration)
+        : CatalogProduct(move(name), pr, stock, dosage, move(expiration)) {}
+
+    // Constructor for a façade over an existing store row
+    Pharmacy(ProductStore* backing, uint32_t id) : CatalogProduct(backing, id) {}
+
+    int getDosage() const { return getIntegerField(); } // Milligrams
+    string_view getExpirationDate() const { return getTextField(); }
+};
+
+// Call visit with the product cast to its concrete type. The registry's tag
+// dispatch replaces a virtual call, and each case can be inlined.
+template <typename Visitor>
+decltype(auto) visitProduct(const Product& product, Visitor&& visit) {
+    return ProductTypes::dispatch(product.getTypeTag(), [&](auto declared) -> decltype(auto) {
+        return visit(static_cast<const typename decltype(declared)::type::Facade&>(product));
+    });
+}
+
+inline void Product::displayProduct() const {
+    visitProduct(*this, [](const auto& concrete) { concrete.displayProduct(); });
+}
+
+// Operations with their own call counter and latency histogram
+enum class MetricOp : uint8_t { Sell, Discount, Restock, Save, Load, Checkpoint, LogFlush };
+inline constexpr size_t metricOpCount = 7;
+inline constexpr string_view metricOpNames[metricOpCount] = { "sell", "discount", "restock", "save", "load", "checkpoint", "log_flush" };
+
+// Files whose written bytes are counted
+enum class MetricSink : uint8_t { TransactionLog, WriteAheadLog, InventoryFile, Snapshot };
+inline constexpr size_t metricSinkCount = 4;
+inline constexpr string_view metricSinkNames[metricSinkCount] = { "transaction_log", "wal", "inventory_file", "snapshot" };
+
+/*
+ * Process-wide operation metrics.
+ * Latencies go into HDR-style log-linear histograms: exact below 8 ns, then
+ * 8 sub-buckets per power of two (about 12% resolution) up to ~68 s. The
+ * first 32 threads that record each own a shard and update it with plain
+ * relaxed loads and stores (no locked instructions); later threads share one
+ * overflow shard updated with atomic adds. snapshot() merges the shards.
+ * Every call is counted, but hot point operations time only a sample of
+ * their calls (see OperationTimer), since the two clock reads cost far more
+ * than the counter updates.
+ * Building with INVENTORY_METRICS=0 removes the shards and makes every
+ * recording call an empty inline function.
+ */
+class InventoryMetrics {
+public:
+    static constexpr size_t bucketCount = 8 + 33 * 8;
+
+    // A merged copy of every shard, plus gauges filled in by the manager
+    struct Snapshot {
+        struct Operation {
+            uint64_t calls = 0;
+            uint64_t failures = 0;
+            uint64_t timedCalls = 0; // Calls whose latency was measured
+            uint64_t totalNs = 0;    // Sum over the timed calls
+            uint64_t buckets[bucketCount] = {};
+
+            // Latency at quantile q (0..1) of the timed calls, reported as the upper edge of its bucket
+            uint64_t percentileNs(double q) const {
+                if (timedCalls == 0) return 0;
+                uint64_t rank = static_cast<uint64_t>(ceil(q * timedCalls));
+                uint64_t seen = 0;
+                for (size_t bucket = 0; bucket < bucketCount; ++bucket) {
+                    seen += buckets[bucket];
+                    if (seen >= max<uint64_t>(rank, 1)) return bucketLimit(bucket) - 1;
+                }
+                return bucketLimit(bucketCount - 1) - 1;
+            }
+        };
+
+        bool enabled = INVENTORY_METRICS != 0;
+        Operation operations[metricOpCount];
+        uint64_t bytesWritten[metricSinkCount] = {};
+        uint64_t logQueueDepth = 0;
+        uint64_t logRecordsDropped = 0;
+        uint8_t replicationRole = 0; // See ReplicationGauges
+        uint64_t replicationSequence = 0;
+        uint64_t replicationSubscribers = 0;
+        uint64_t replicationLagRecords = 0;
+        uint64_t replicationLagMs = 0;
+
+        const Operation& operator[](MetricOp op) const { return operations[static_cast<size_t>(op)]; }
+    };
+
+    // Histogram bucket for a latency in nanoseconds
+    static size_t bucketOf(uint64_t ns) {
+        if (ns < 8) return static_cast<size_t>(ns);
+        size_t exponent = static_cast<size_t>(bit_width(ns)) - 1; // >= 3
+        size_t bucket = 8 + (exponent - 3) * 8 + ((ns >> (exponent - 3)) & 7);
+        return min(bucket, bucketCount - 1);
+    }
+
+    // One past the largest latency a bucket holds
+    static uint64_t bucketLimit(size_t bucket) {
+        if (bucket < 8) return bucket + 1;
+        size_t exponent = (bucket - 8) / 8 + 3;
+        return (8 + (bucket - 8) % 8 + 1) << (exponent - 3);
+    }
+
+    static int64_t nowNs() {
+        return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+#if INVENTORY_METRICS
+private:
+    static constexpr size_t ownedShards = 32; // Shard ownedShards is the shared overflow shard
+
+    struct alignas(64) Shard {
+        atomic<uint64_t> calls[metricOpCount];
+        atomic<uint64_t> failures[metricOpCount];
+        atomic<uint64_t> timedCalls[metricOpCount];
+        atomic<uint64_t> totalNs[metricOpCount];
+        atomic<uint64_t> buckets[metricOpCount][bucketCount];
+        atomic<uint64_t> bytesWritten[metricSinkCount];
+    };
+
+    Shard shards[ownedShards + 1];
+
+    // Shard of the calling thread, handed out in order on first use
+    static size_t threadShard() {
+        static atomic<size_t> nextShard{ 0 };
+        thread_local size_t shard = min(nextShard.fetch_add(1, memory_order_relaxed), ownedShards);
+        return shard;
+    }
+
+    // Add to a counter; only the owning thread writes an owned shard, so no RMW is needed
+    static void bump(atomic<uint64_t>& counter, uint64_t amount, bool owned) {
+        if (owned) counter.store(counter.load(memory_order_relaxed) + amount, memory_order_relaxed);
+        else counter.fetch_add(amount, memory_order_relaxed);
+    }
+
+public:
+    // Count one call of `op` that was not timed
+    void count(MetricOp op, bool failed) {
+        const size_t index = threadShard();
+        const bool owned = index < ownedShards;
+        const size_t o = static_cast<size_t>(op);
+        bump(shards[index].calls[o], 1, owned);
+        if (failed) bump(shards[index].failures[o], 1, owned);
+    }
+
+    // Count one call of `op` that took `ns` nanoseconds
+    void record(MetricOp op, int64_t ns, bool failed) {
+        const size_t index = threadShard();
+        const bool owned = index < ownedShards;
+        Shard& shard = shards[index];
+        const size_t o = static_cast<size_t>(op);
+        const uint64_t elapsed = ns > 0 ? static_cast<uint64_t>(ns) : 0;
+        bump(shard.calls[o], 1, owned);
+        bump(shard.timedCalls[o], 1, owned);
+        bump(shard.totalNs[o], elapsed, owned);
+        bump(shard.buckets[o][bucketOf(elapsed)], 1, owned);
+        if (failed) bump(shard.failures[o], 1, owned);
+    }
+
+    void addBytes(MetricSink sink, uint64_t bytes) {
+        const size_t index = threadShard();
+        bump(shards[index].bytesWritten[static_cast<size_t>(sink)], bytes, index < ownedShards);
+    }
+
+    // Merge every shard; the gauges are left for the caller
+    Snapshot snapshot() const {
+        Snapshot merged;
+        for (const Shard& shard : shards) {
+            for (size_t o = 0; o < metricOpCount; ++o) {
+                Snapshot::Operation& op = merged.operations[o];
+                op.calls += shard.calls[o].load(memory_order_relaxed);
+                op.failures += shard.failures[o].load(memory_order_relaxed);
+                op.timedCalls += shard.timedCalls[o].load(memory_order_relaxed);
+                op.totalNs += shard.totalNs[o].load(memory_order_relaxed);
+                for (size_t bucket = 0; bucket < bucketCount; ++bucket) {
+                    op.buckets[bucket] += shard.buckets[o][bucket].load(memory_order_relaxed);
+                }
+            }
+            for (size_t s = 0; s < metricSinkCount; ++s) {
+                merged.bytesWritten[s] += shard.bytesWritten[s].load(memory_order_relaxed);
+            }
+        }
+        return merged;
+    }
+#else
+public:
+    void count(MetricOp, bool) {}
+    void record(MetricOp, int64_t, bool) {}
+    void addBytes(MetricSink, uint64_t) {}
+    Snapshot snapshot() const { return Snapshot(); }
+#endif
+};
+
+inline InventoryMetrics inventoryMetrics;
+
+// Log shipping state for the metrics dump, set by the replication publisher
+// (primary) or subscriber (replica) of this process
+struct ReplicationGauges {
+    enum Role : uint8_t { None = 0, Primary = 1, Replica = 2 };
+    atomic<uint8_t> role{ None };
+    atomic<uint64_t> sequence{ 0 };    // Last record shipped (primary) or applied (replica)
+    atomic<uint64_t> subscribers{ 0 }; // Primary: connected replicas
+    atomic<uint64_t> lagRecords{ 0 };  // Replica: records the primary has flushed but this replica has not applied
+    atomic<uint64_t> lagMs{ 0 };       // Replica: age of the newest applied change while behind, 0 when caught up
+};
+
+inline ReplicationGauges replicationGauges;
+
+/*
+ * RAII timer for one instrumented operation.
+ * Counts the call in inventoryMetrics when it goes out of scope; track()
+ * marks it as failed when the operation reports false. With a sample period
+ * of N (a power of two), only every Nth call on a thread reads the clock;
+ * hot per-item paths use hotSamplePeriod.
+ */
+class OperationTimer {
+public:
+    static constexpr uint32_t hotSamplePeriod = 8;
+
+#if INVENTORY_METRICS
+private:
+    MetricOp op;
+    int64_t start = 0;
+    bool timed;
+    bool failed = false;
+
+    static bool sampleNext(uint32_t period) {
+        thread_local uint32_t calls = 0;
+        return (++calls & (period - 1)) == 0;
+    }
+
+public:
+    explicit OperationTimer(MetricOp operation, uint32_t samplePeriod = 1)
+        : op(operation), timed(samplePeriod <= 1 || sampleNext(samplePeriod)) {
+        if (timed) start = InventoryMetrics::nowNs();
+    }
+    ~OperationTimer() {
+        if (timed) inventoryMetrics.record(op, InventoryMetrics::nowNs() - start, failed);
+        else inventoryMetrics.count(op, failed);
+    }
+
+    bool track(bool ok) {
+        failed = !ok;
+        return ok;
+    }
+#else
+public:
+    explicit OperationTimer(MetricOp, uint32_t = 1) {}
+    bool track(bool ok) { return ok; }
+#endif
+    OperationTimer(const OperationTimer&) = delete;
+    OperationTimer& operator=(const OperationTimer&) = delete;
+};
+
+// Render a metrics snapshot in the Prometheus text exposition format
+inline string formatMetricsText(const InventoryMetrics::Snapshot& snapshot) {
+    string out;
+    auto line = [&out](string_view name, string_view labels, uint64_t value) {
+        out += name;
+        if (!labels.empty()) {
+            out += '{';
+            out += labels;
+            out += '}';
+        }
+        out += ' ';
+        out += to_string(value);
+        out += '\n';
+    };
+
+    if (snapshot.enabled) {
+        out += "# HELP inventory_operations_total Calls per instrumented operation.\n"
+            "# TYPE inventory_operations_total counter\n";
+        for (size_t o = 0; o < metricOpCount; ++o) {
+            line("inventory_operations_total", "op=\"" + string(metricOpNames[o]) + "\"", snapshot.operations[o].calls);
+        }
+        out += "# HELP inventory_operation_failures_total Calls that reported failure.\n"
+            "# TYPE inventory_operation_failures_total counter\n";
+        for (size_t o = 0; o < metricOpCount; ++o) {
+            line("inventory_operation_failures_total", "op=\"" + string(metricOpNames[o]) + "\"", snapshot.operations[o].failures);
+        }
+        out += "# HELP inventory_operation_latency_ns Operation latency in nanoseconds (hot paths are sampled).\n"
+            "# TYPE inventory_operation_latency_ns summary\n";
+        for (size_t o = 0; o < metricOpCount; ++o) {
+            const InventoryMetrics::Snapshot::Operation& op = snapshot.operations[o];
+            string label = "op=\"" + string(metricOpNames[o]) + "\"";
+            for (const char* quantile : { "0.5", "0.9", "0.99", "0.999" }) {
+                line("inventory_operation_latency_ns", label + ",quantile=\"" + quantile + "\"", op.percentileNs(atof(quantile)));
+            }
+            line("inventory_operation_latency_ns_sum", label, op.totalNs);
+            line("inventory_operation_latency_ns_count", label, op.timedCalls);
+        }
+        out += "# HELP inventory_bytes_written_total Bytes written per file kind.\n"
+            "# TYPE inventory_bytes_written_total counter\n";
+        for (size_t s = 0; s < metricSinkCount; ++s) {
+            line("inventory_bytes_written_total", "file=\"" + string(metricSinkNames[s]) + "\"", snapshot.bytesWritten[s]);
+        }
+    }
+    else {
+        out += "# Operation metrics were disabled at build time (INVENTORY_METRICS=0).\n";
+    }
+    out += "# HELP inventory_log_queue_depth Log records waiting for the writer thread.\n"
+        "# TYPE inventory_log_queue_depth gauge\n";
+    line("inventory_log_queue_depth", "", snapshot.logQueueDepth);
+    out += "# HELP inventory_log_records_dropped_total Text log lines discarded because the queue was full; write-ahead log records are never dropped.\n"
+        "# TYPE inventory_log_records_dropped_total counter\n";
+    line("inventory_log_records_dropped_total", "", snapshot.logRecordsDropped);
+    if (snapshot.replicationRole == ReplicationGauges::Primary) {
+        out += "# HELP inventory_replication_sequence Last WAL record shipped to replicas.\n"
+            "# TYPE inventory_replication_sequence gauge\n";
+        line("inventory_replication_sequence", "", snapshot.replicationSequence);
+        out += "# HELP inventory_replication_subscribers Connected read replicas.\n"
+            "# TYPE inventory_replication_subscribers gauge\n";
+        line("inventory_replication_subscribers", "", snapshot.replicationSubscribers);
+    }
+    else if (snapshot.replicationRole == ReplicationGauges::Replica) {
+        out += "# HELP inventory_replication_sequence Last WAL record applied from the primary.\n"
+            "# TYPE inventory_replication_sequence gauge\n";
+        line("inventory_replication_sequence", "", snapshot.replicationSequence);
+        out += "# HELP inventory_replication_lag_records Records flushed on the primary but not yet applied here.\n"
+            "# TYPE inventory_replication_lag_records gauge\n";
+        line("inventory_replication_lag_records", "", snapshot.replicationLagRecords);
+        out += "# HELP inventory_replication_lag_ms Age of the newest applied change while behind the primary.\n"
+            "# TYPE inventory_replication_lag_ms gauge\n";
+        line("inventory_replication_lag_ms", "", snapshot.replicationLagMs);
+    }
+    return out;
+}
+
+/*
+ * Long-lived transaction logger.
+ * Keeps the log file open, buffers formatted records in memory and writes
+ * them out in batches instead of opening, flushing and closing the file
+ * for every transaction.
+ */
+class TransactionLogger {
+public:
+    // How much throughput is traded for crash safety
+    enum class DurabilityMode {
+        FlushEachRecord, // Write and flush every record immediately (safest, slowest)
+        GroupCommit,     // Flush when a batch fills or the time window passes
+        Async            // A background thread flushes on the time window
+    };
+
+private:
+    ofstream logFile;
+    string buffer;                       // Records waiting to be written
+    size_t pendingRecords = 0;           // Number of records in the buffer
+    size_t batchSize;                    // Flush once this many records are buffered
+    chrono::milliseconds flushInterval;  // Flush once this much time has passed
+    chrono::steady_clock::time_point lastFlush;
+    DurabilityMode mode;
+
+    mutex bufferMutex;
+    condition_variable flushSignal;
+    thread flusherThread;
+    bool stopping = false;
+
+    // Write the buffered records to the file (caller must hold bufferMutex)
+    void flushLocked() {
+        if (!buffer.empty()) {
+            logFile.write(buffer.data(), static_cast<streamsize>(buffer.size()));
+            logFile.flush();
+            inventoryMetrics.addBytes(MetricSink::TransactionLog, buffer.size());
+            buffer.clear();
+            pendingRecords = 0;
+        }
+        lastFlush = chrono::steady_clock::now();
+    }
+
+    // Background loop used by Async mode: flush whenever the window passes or a batch fills
+    void flusherLoop() {
+        unique_lock<mutex> lock(bufferMutex);
+        while (!stopping) {
+            flushSignal.wait_for(lock, flushInterval);
+            flushLocked();
+        }
+        flushLocked();
+    }
+
+public:
+    // Open the log file for appending and start the flusher thread if needed
+    TransactionLogger(const string& fileName = "transaction_log.txt",
+        DurabilityMode durability = DurabilityMode::GroupCommit,
+        size_t batch = 256,
+        chrono::milliseconds interval = chrono::milliseconds(1000))
+        : logFile(fileName, ios::app), batchSize(batch > 0 ? batch : 1),
+        flushInterval(interval), lastFlush(chrono::steady_clock::now()), mode(durability) {
+        buffer.reserve(batchSize * 64);
+        if (mode == DurabilityMode::Async) {
+            flusherThread = thread(&TransactionLogger::flusherLoop, this);
+        }
+    }
+
+    TransactionLogger(const TransactionLogger&) = delete;
+    TransactionLogger& operator=(const TransactionLogger&) = delete;
+
+    // Drain everything that is still buffered before the file is closed
+    ~TransactionLogger() {
+        if (flusherThread.joinable()) {
+            {
+                lock_guard<mutex> lock(bufferMutex);
+                stopping = true;
+            }
+            flushSignal.notify_one();
+            flusherThread.join();
+        }
+        else {
+            lock_guard<mutex> lock(bufferMutex);
+            flushLocked();
+        }
+    }
+
+    // Append one formatted record (must already end with a newline)
+    void append(const string& record) {
+        lock_guard<mutex> lock(bufferMutex);
+        buffer += record;
+        ++pendingRecords;
+
+        if (mode == DurabilityMode::FlushEachRecord) {
+            flushLocked();
+        }
+        else if (mode == DurabilityMode::GroupCommit) {
+            if (pendingRecords >= batchSize || chrono::steady_clock::now() - lastFlush >= flushInterval) {
+                flushLocked();
+            }
+        }
+        else if (pendingRecords >= batchSize) {
+            flushSignal.notify_one(); // Let the background thread do the write
+        }
+    }
+
+    // Force all buffered records out to the file
+    void flush() {
+        lock_guard<mutex> lock(bufferMutex);
+        flushLocked();
+    }
+
+    DurabilityMode getMode() const { return mode; }
+};
+
+/*
+ * Bounded lock-free multi-producer / single-consumer ring queue.
+ * Each cell carries a sequence number so producers can claim slots with a
+ * single CAS and the consumer can tell when a slot has been published.
+ */
+template <typename T>
+class MpscQueue {
+private:
+    struct Cell {
+        atomic<size_t> sequence;
+        T value;
+    };
+
+    unique_ptr<Cell[]> cells;
+    size_t mask;
+    alignas(64) atomic<size_t> enqueuePos{ 0 };
+    alignas(64) size_t dequeuePos = 0; // Only touched by the consumer
+
+public:
+    // Capacity is rounded up to the next power of two
+    explicit MpscQueue(size_t requested) {
+        size_t capacity = 2;
+        while (capacity < requested) capacity <<= 1;
+        cells.reset(new Cell[capacity]);
+        mask = capacity - 1;
+        for (size_t i = 0; i < capacity; ++i) {
+            cells[i].sequence.store(i, memory_order_relaxed);
+        }
+    }
+
+    // Try to publish a value; returns false if the queue is full
+    bool tryPush(const T& value) {
+        size_t pos = enqueuePos.load(memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &cells[pos & mask];
+            size_t seq = cell->sequence.load(memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) break;
+            }
+            else if (diff < 0) {
+                return false; // Full
+            }
+            else {
+                pos = enqueuePos.load(memory_order_relaxed);
+            }
+        }
+        cell->value = value;
+        cell->sequence.store(pos + 1, memory_order_release);
+        return true;
+    }
+
+    // Try to publish `count` values in consecutive slots with a single claim.
+    // Slots are freed in order, so if the last one is free the whole run is.
+    bool tryPushBatch(const T* values, size_t count) {
+        if (count == 0) return true;
+        if (count > mask + 1) return false;
+        size_t pos = enqueuePos.load(memory_order_relaxed);
+        while (true) {
+            size_t seq = cells[(pos + count - 1) & mask].sequence.load(memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + count - 1);
+            if (diff == 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + count, memory_order_relaxed)) break;
+            }
+            else if (diff < 0) {
+                return false; // Not enough room yet
+            }
+            else {
+                pos = enqueuePos.load(memory_order_relaxed);
+            }
+        }
+        for (size_t i = 0; i < count; ++i) {
+            Cell& cell = cells[(pos + i) & mask];
+            cell.value = values[i];
+            cell.sequence.store(pos + i + 1, memory_order_release);
+        }
+        return true;
+    }
+
+    // Try to take the oldest value (single consumer only)
+    bool tryPop(T& out) {
+        Cell* cell = &cells[dequeuePos & mask];
+        size_t seq = cell->sequence.load(memory_order_acquire);
+        if (static_cast<intptr_t>(seq) - static_cast<intptr_t>(dequeuePos + 1) != 0) {
+            return false; // Empty, or the producer has not finished publishing
+        }
+        out = cell->value;
+        cell->sequence.store(dequeuePos + mask + 1, memory_order_release);
+        ++dequeuePos;
+        return true;
+    }
+
+    size_t capacity() const { return mask + 1; }
+};
+
+/*
+ * Timestamp source for the logging hot path.
+ * Reads only the monotonic clock; wall-clock time is derived from an offset
+ * calibrated against system_clock, which the log writer refreshes about once a
+ * second so clock adjustments are still picked up.
+ */
+class TimestampClock {
+    inline static atomic<int64_t> epochOffsetNs{ 0 };
+    inline static atomic<bool> calibrated{ false };
+
+public:
+    // Both views of one instant, in nanoseconds
+    struct Timestamp {
+        int64_t epochNs;     // Wall-clock time since the epoch
+        int64_t monotonicNs; // steady_clock time, for measuring intervals
+    };
+
+    static int64_t monotonicNs() {
+        return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Re-measure the offset between the wall clock and the monotonic clock
+    static void recalibrate() {
+        int64_t wall = chrono::duration_cast<chrono::nanoseconds>(chrono::system_clock::now().time_since_epoch()).count();
+        epochOffsetNs.store(wall - monotonicNs(), memory_order_relaxed);
+        calibrated.store(true, memory_order_release);
+    }
+
+    // Current time from a single monotonic clock read
+    static Timestamp now() {
+        if (!calibrated.load(memory_order_acquire)) recalibrate();
+        int64_t mono = monotonicNs();
+        return Timestamp{ mono + epochOffsetNs.load(memory_order_relaxed), mono };
+    }
+};
+
+/*
+ * Formats epoch timestamps as "YYYY-MM-DD HH:MM:SS.mmm".
+ * The date and time prefix is cached and only rebuilt when the second
+ * changes, so localtime and strftime run at most once per second instead of
+ * once per record. Not thread-safe; each writer owns one.
+ */
+class TimestampFormatter {
+    int64_t cachedSecond = INT64_MIN;
+    char prefix[32];
+    size_t prefixLength = 0;
+
+public:
+    // Replace out with the formatted timestamp; returns true when a new second started
+    bool format(int64_t epochNs, string& out) {
+        int64_t second = epochNs / 1000000000LL;
+        int64_t millis = (epochNs % 1000000000LL) / 1000000LL;
+        if (millis < 0) {
+            --second;
+            millis += 1000;
+        }
+
+        bool rolled = second != cachedSecond;
+        if (rolled) {
+            time_t seconds = static_cast<time_t>(second);
+            std::tm localTime;
+#ifdef _WIN32
+            localtime_s(&localTime, &seconds);
+#else
+            localtime_r(&seconds, &localTime);
+#endif
+            prefixLength = std::strftime(prefix, sizeof(prefix), "%Y-%m-%d %H:%M:%S", &localTime);
+            cachedSecond = second;
+        }
+
+        char fraction[4] = { '.', static_cast<char>('0' + millis / 100), static_cast<char>('0' + millis / 10 % 10), static_cast<char>('0' + millis % 10) };
+        out.assign(prefix, prefixLength);
+        out.append(fraction, sizeof(fraction));
+        return rolled;
+    }
+};
+
+// Kind of operation recorded in the transaction log
+// AddProduct and ItemDiscount only go to the write-ahead log, not the text log.
+// New ops are appended so values already in a write-ahead log keep their meaning.
+enum class LogOp : uint8_t { Sale, Discount, Restock, BulkDiscount, AddProduct, ItemDiscount, Expire };
+
+// Fixed-size binary log record handed from callers to the writer thread.
+// BulkDiscount records carry the ProductTypeTag filter (0 for a custom
+// predicate) in productId and the number of discounted items in quantity.
+// AddProduct records carry the initial stock in quantity and the price in
+// percentage; the remaining fields come from the registered product.
+struct LogRecord {
+    LogOp op;
+    uint32_t productId;
+    int32_t quantity;     // Units sold or restocked
+    double percentage;    // Discount percentage
+    TimestampClock::Timestamp stamp; // Raw time of the operation; formatted by the writer
+};
+
+// 32-bit FNV-1a checksum over a byte range
+inline uint32_t fnv1a32(const char* data, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Read an entire file into memory with a single read; returns false if it cannot be opened
+inline bool readWholeFile(const string& fileName, string& contents) {
+    ifstream inFile(fileName, ios::binary | ios::ate);
+    if (!inFile) return false;
+    streamsize size = inFile.tellg();
+    contents.assign(size > 0 ? static_cast<size_t>(size) : 0, '\0');
+    if (size > 0) {
+        inFile.seekg(0);
+        inFile.read(&contents[0], size);
+        contents.resize(static_cast<size_t>(inFile.gcount()));
+    }
+    return true;
+}
+
+// A second handle on a file that forces data written through other handles
+// (such as an ofstream, which has no fsync) onto the disk. flush() on a
+// stream only hands the bytes to the OS, which survives a process crash but
+// not a power loss or kernel crash; sync() survives those too.
+class FileSyncHandle {
+private:
+#ifdef _WIN32
+    HANDLE handle = INVALID_HANDLE_VALUE;
+#else
+    int fd = -1;
+#endif
+
+public:
+    FileSyncHandle() = default;
+    explicit FileSyncHandle(const string& path) { open(path); }
+    ~FileSyncHandle() { close(); }
+    FileSyncHandle(const FileSyncHandle&) = delete;
+    FileSyncHandle& operator=(const FileSyncHandle&) = delete;
+
+    // Attach to an existing file; false if it cannot be opened
+    bool open(const string& path) {
+        close();
+#ifdef _WIN32
+        handle = CreateFileA(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+            nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        return handle != INVALID_HANDLE_VALUE;
+#else
+        fd = ::open(path.c_str(), O_WRONLY | O_CLOEXEC);
+        return fd >= 0;
+#endif
+    }
+
+    void close() {
+#ifdef _WIN32
+        if (handle != INVALID_HANDLE_VALUE) CloseHandle(handle);
+        handle = INVALID_HANDLE_VALUE;
+#else
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+#endif
+    }
+
+    // Wait until everything written to the file so far is on the disk
+    bool sync() {
+#ifdef _WIN32
+        return handle != INVALID_HANDLE_VALUE && FlushFileBuffers(handle);
+#else
+        return fd >= 0 && ::fsync(fd) == 0;
+#endif
+    }
+};
+
+// Force a file's contents onto the disk; false if it cannot be opened or synced
+inline bool syncFile(const string& path) {
+    FileSyncHandle handle(path);
+    return handle.sync();
+}
+
+// Make a rename into the directory holding `path` durable. POSIX keeps
+// directory entries separately from file data; Windows needs nothing extra.
+inline void syncParentDirectory(const string& path) {
+#ifndef _WIN32
+    string directory = filesystem::path(path).parent_path().string();
+    int fd = ::open(directory.empty() ? "." : directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) return;
+    ::fsync(fd);
+    ::close(fd);
+#else
+    (void)path;
+#endif
+}
+
+// Longest product name or text field that can be stored: write-ahead log
+// records and binary snapshot records keep string lengths in 16 bits
+constexpr size_t maxStoredStringLength = UINT16_MAX;
+
+// Fixed part of a write-ahead log record; the name and detail strings follow it
+struct WalPayload {
+    int64_t timestampNs;
+    double value;          // Discount percentage, or price for AddProduct
+    uint32_t productId;
+    int32_t quantity;
+    int32_t integerField;  // AddProduct only: the type's Integer field (warranty months, ...)
+    uint16_t nameLength;   // AddProduct only
+    uint16_t detailLength; // AddProduct only: the type's Text or Date field
+    uint8_t op;            // LogOp
+    uint8_t type;          // ProductTypeTag, AddProduct only
+    uint8_t padding[6];
+};
+
+struct WalRecordHeader {
+    uint32_t payloadSize; // WalPayload plus trailing strings
+    uint32_t checksum;    // FNV-1a over the sequence number and payload
+    uint64_t sequence;
+};
+
+static_assert(sizeof(WalPayload) == 40, "WAL payload layout changed");
+static_assert(sizeof(WalRecordHeader) == 16, "WAL record header layout changed");
+
+// One decoded log record; the strings point into the scanned image
+struct WalEntry {
+    uint64_t sequence;
+    WalPayload payload;
+    string_view name;
+    string_view detail;
+};
+
+// What the writer knows about a product: its name for the text log and the
+// attributes needed to replay an AddProduct record. The strings are views into
+// the InventoryManager's CatalogArena, which outlives the log pipeline.
+struct RegisteredProduct {
+    string_view name;
+    ProductTypeTag type = ProductTypeTag::Electronics;
+    int32_t integerField = 0; // See ProductStore for the field slots
+    string_view textField;
+};
+
+/*
+ * Binary write-ahead log.
+ * File layout: "INVW" + uint32 version, then records of WalRecordHeader +
+ * WalPayload + strings. Every record has a sequence number and a checksum, so
+ * recovery can stop cleanly at a torn or corrupt tail. Only the log writer
+ * thread appends to it.
+ */
+class WriteAheadLog {
+private:
+    static constexpr uint32_t version = 1;
+
+    string path;
+    ofstream file;
+    FileSyncHandle syncHandle; // fsyncs what `file` has written
+    string buffer;
+    uint64_t nextSequence;
+    mutex observerMutex;
+    function<void(string_view, uint64_t)> observer; // Sees every flushed batch (log shipping)
+
+    // Open for appending, writing the file header if the file is new or empty
+    void open() {
+        bool fresh = !filesystem::exists(path) || filesystem::file_size(path) == 0;
+        file.open(path, ios::binary | ios::app);
+        if (fresh) {
+            file.write("INVW", 4);
+            file.write(reinterpret_cast<const char*>(&version), sizeof(version));
+            file.flush();
+        }
+        syncHandle.open(path);
+        if (fresh) syncHandle.sync();
+    }
+
+public:
+    static constexpr size_t fileHeaderSize = 8;
+
+    WriteAheadLog(const string& fileName, uint64_t firstSequence) : path(fileName), nextSequence(firstSequence) {
+        open();
+    }
+
+    // Encode one record with the next sequence number into the write buffer
+    void append(const LogRecord& record, const RegisteredProduct* product) {
+        WalPayload payload = {};
+        payload.timestampNs = record.stamp.epochNs;
+        payload.value = record.percentage;
+        payload.productId = record.productId;
+        payload.quantity = record.quantity;
+        payload.op = static_cast<uint8_t>(record.op);
+        if (record.op == LogOp::AddProduct && product) {
+            payload.type = static_cast<uint8_t>(product->type);
+            payload.integerField = product->integerField;
+            // addProductLocked rejects strings longer than maxStoredStringLength
+            payload.nameLength = static_cast<uint16_t>(product->name.size());
+            payload.detailLength = static_cast<uint16_t>(product->textField.size());
+        }
+
+        WalRecordHeader header;
+        header.sequence = nextSequence++;
+        header.payloadSize = static_cast<uint32_t>(sizeof(payload) + payload.nameLength + payload.detailLength);
+
+        size_t start = buffer.size();
+        buffer.resize(start + sizeof(header) + header.payloadSize);
+        char* out = &buffer[start];
+        memcpy(out + sizeof(header), &payload, sizeof(payload));
+        if (payload.nameLength) memcpy(out + sizeof(header) + sizeof(payload), product->name.data(), payload.nameLength);
+        if (payload.detailLength) {
+            memcpy(out + sizeof(header) + sizeof(payload) + payload.nameLength, product->textField.data(), payload.detailLength);
+        }
+        memcpy(out + sizeof(header) - sizeof(header.sequence), &header.sequence, sizeof(header.sequence));
+        header.checksum = fnv1a32(out + sizeof(header) - sizeof(header.sequence), sizeof(header.sequence) + header.payloadSize);
+        memcpy(out, &header, sizeof(header));
+    }
+
+    // Write everything appended so far and wait until it is on the disk, so
+    // flushed records survive power loss as well as a process crash. Replicas
+    // only see records once they are durable here.
+    void flush() {
+        if (buffer.empty()) return;
+        file.write(buffer.data(), static_cast<streamsize>(buffer.size()));
+        file.flush();
+        syncHandle.sync();
+        inventoryMetrics.addBytes(MetricSink::WriteAheadLog, buffer.size());
+        {
+            lock_guard<mutex> lock(observerMutex);
+            if (observer) observer(buffer, nextSequence - 1);
+        }
+        buffer.clear();
+    }
+
+    // Call observer(frames, lastSequence) with the records of every flush from
+    // now on, on the flushing thread; an empty function stops the calls
+    void setFlushObserver(function<void(string_view frames, uint64_t lastSequence)> callback) {
+        lock_guard<mutex> lock(observerMutex);
+        observer = move(callback);
+    }
+
+    // Drop every record with a sequence number <= `through` (already covered
+    // by a checkpoint). The survivors are written to a temp file that
+    // atomically replaces the log.
+    void compact(uint64_t through) {
+        flush();
+        file.close();
+        syncHandle.close();
+        string image;
+        if (readWholeFile(path, image)) {
+            string kept(image, 0, min(image.size(), fileHeaderSize));
+            scan(image, [&](const WalEntry& entry, string_view raw) {
+                if (entry.sequence > through) kept.append(raw.data(), raw.size());
+            });
+            string tempPath = path + ".tmp";
+            {
+                ofstream out(tempPath, ios::binary | ios::trunc);
+                out.write(kept.data(), static_cast<streamsize>(kept.size()));
+            }
+            syncFile(tempPath); // The survivors must be on disk before they replace the log
+            error_code ec;
+            filesystem::rename(tempPath, path, ec);
+            if (!ec) syncParentDirectory(path);
+        }
+        open();
+    }
+
+    uint64_t lastSequence() const { return nextSequence - 1; }
+
+    // Decode an in-memory log image, calling visit(entry, rawBytes) for each
+    // intact record in order. Returns the length of the intact prefix, which is
+    // where a torn tail should be cut off (0 if the file header is bad).
+    template <typename Visitor>
+    static size_t scan(string_view image, Visitor visit) {
+        if (image.size() < fileHeaderSize || image.substr(0, 4) != "INVW") return 0;
+        return fileHeaderSize + scanFrames(image.substr(fileHeaderSize), visit);
+    }
+
+    // scan() over bare records without the file header, as shipped to replicas
+    template <typename Visitor>
+    static size_t scanFrames(string_view image, Visitor visit) {
+        size_t pos = 0;
+        while (image.size() - pos >= sizeof(WalRecordHeader)) {
+            WalRecordHeader header;
+            memcpy(&header, image.data() + pos, sizeof(header));
+            if (header.payloadSize < sizeof(WalPayload) || image.size() - pos - sizeof(header) < header.payloadSize) break;
+            const char* checked = image.data() + pos + sizeof(header) - sizeof(header.sequence);
+            if (fnv1a32(checked, sizeof(header.sequence) + header.payloadSize) != header.checksum) break;
+
+            WalEntry entry;
+            entry.sequence = header.sequence;
+            memcpy(&entry.payload, image.data() + pos + sizeof(header), sizeof(WalPayload));
+            size_t strings = pos + sizeof(header) + sizeof(WalPayload);
+            if (sizeof(WalPayload) + entry.payload.nameLength + entry.payload.detailLength != header.payloadSize) break;
+            entry.name = image.substr(strings, entry.payload.nameLength);
+            entry.detail = image.substr(strings + entry.payload.nameLength, entry.payload.detailLength);
+            visit(entry, image.substr(pos, sizeof(header) + header.payloadSize));
+            pos += sizeof(header) + header.payloadSize;
+        }
+        return pos;
+    }
+};
+
+/*
+ * Asynchronous log pipeline.
+ * Callers push LogRecords onto a lock-free queue; a background writer thread
+ * formats them into text and hands them to a TransactionLogger sink, so the
+ * caller never pays for formatting or disk I/O.
+ */
+class AsyncLogPipeline {
+public:
+    // What submit() does when the queue is full. Drop only ever sheds text log
+    // lines: once a write-ahead log is attached every record is still queued
+    // (blocking if needed), and the writer skips the text line of records it
+    // takes while more than half the queue is backed up.
+    enum class OverflowPolicy {
+        Block, // Wait for the writer to make room (never loses records)
+        Drop   // Discard the text log line and count it
+    };
+
+private:
+    MpscQueue<LogRecord> queue;
+    OverflowPolicy policy;
+    TransactionLogger sink;
+
+    mutex namesMutex;
+    vector<RegisteredProduct> products; // Product id -> name and attributes, used only by the writer
+
+    unique_ptr<WriteAheadLog> walOwner;
+    atomic<WriteAheadLog*> wal{ nullptr };   // Set once recovery has finished
+    atomic<uint64_t> compactThrough{ 0 };    // Pending WAL compaction request (0 = none)
+
+    atomic<uint64_t> submitted{ 0 };
+    atomic<uint64_t> dropped{ 0 };
+    atomic<uint64_t> consumed{ 0 }; // Records taken off the queue by the writer
+    atomic<uint64_t> written{ 0 };  // Records formatted and flushed by the writer
+    atomic<bool> stopping{ false };
+
+    mutex waitMutex;
+    condition_variable wakeWriter;
+    condition_variable drained;
+    thread writerThread;
+    TimestampFormatter timestampFormatter; // Used only by the writer thread
+
+    // Turn one binary record into a text log line
+    void formatRecord(const LogRecord& record, string& out) {
+        // Piggyback clock recalibration on the once-per-second prefix refresh
+        if (timestampFormatter.format(record.stamp.epochNs, out)) TimestampClock::recalibrate();
+
+        if (record.op == LogOp::BulkDiscount) {
+            if (ProductTypes::isKnown(record.productId)) {
+                out += " Bulk Discount - All ";
+                out += productTypeName(static_cast<ProductTypeTag>(record.productId));
+            }
+            else {
+                out += " Bulk Discount - Selected Products";
+            }
+            out += " | Items: " + to_string(record.quantity);
+        }
+        else {
+            lock_guard<mutex> lock(namesMutex);
+            out += record.op == LogOp::Sale ? " Sale - " : record.op == LogOp::Discount ? " Discount - "
+                : record.op == LogOp::Expire ? " Expired - " : " Restock - ";
+            if (record.productId < products.size()) out += products[record.productId].name;
+            else out += "#" + to_string(record.productId);
+        }
+
+        if (record.op == LogOp::Discount || record.op == LogOp::BulkDiscount) {
+            char pct[32];
+            auto converted = to_chars(pct, pct + sizeof(pct), record.percentage, chars_format::general, 6);
+            out += " | Discount: ";
+            out.append(pct, converted.ptr);
+            out += "%\n";
+        }
+        else {
+            out += " | Quantity: " + to_string(record.quantity) + "\n";
+        }
+    }
+
+    // Send one record to the text log and, once enabled, the write-ahead log.
+    // `taken` is how many records the writer has consumed before this one.
+    void consume(const LogRecord& record, string& line, uint64_t taken) {
+        WriteAheadLog* log = wal.load(memory_order_acquire);
+        if (record.op != LogOp::AddProduct && record.op != LogOp::ItemDiscount) {
+            if (log && policy == OverflowPolicy::Drop
+                && submitted.load(memory_order_relaxed) - taken > queue.capacity() / 2) {
+                dropped.fetch_add(1, memory_order_relaxed); // Shed the text line; the WAL still gets the record
+            }
+            else {
+                formatRecord(record, line);
+                sink.append(line);
+            }
+        }
+        if (log) {
+            if (record.op == LogOp::AddProduct) {
+                lock_guard<mutex> lock(namesMutex);
+                log->append(record, record.productId < products.size() ? &products[record.productId] : nullptr);
+            }
+            else {
+                log->append(record, nullptr);
+            }
+        }
+    }
+
+    // Writer loop: drain the queue, flush the sinks when idle, exit once stopped and empty
+    void writerLoop() {
+        LogRecord record;
+        string line;
+        uint64_t formatted = 0;
+        while (true) {
+            bool gotAny = false;
+            while (queue.tryPop(record)) {
+                consume(record, line, formatted);
+                if ((++formatted & 255) == 0) consumed.store(formatted, memory_order_relaxed);
+                gotAny = true;
+            }
+            if (!gotAny) {
+                WriteAheadLog* log = wal.load(memory_order_acquire);
+                uint64_t through = compactThrough.exchange(0, memory_order_acq_rel);
+                if (log && through) log->compact(through);
+                consumed.store(formatted, memory_order_relaxed);
+                if (written.load(memory_order_relaxed) != formatted) {
+                    {
+                        OperationTimer timer(MetricOp::LogFlush);
+                        if (log) log->flush();
+                        sink.flush();
+                    }
+                    {
+                        lock_guard<mutex> lock(waitMutex);
+                        written.store(formatted, memory_order_release);
+                    }
+                    drained.notify_all();
+                }
+                if (stopping.load(memory_order_acquire)) {
+                    if (!queue.tryPop(record)) break;
+                    consume(record, line, formatted);
+                    ++formatted;
+                    continue;
+                }
+                unique_lock<mutex> lock(waitMutex);
+                wakeWriter.wait_for(lock, chrono::milliseconds(1));
+            }
+        }
+    }
+
+public:
+    // Start the writer thread; the sink uses group commit since only the writer touches it
+    AsyncLogPipeline(const string& fileName = "transaction_log.txt",
+        size_t queueCapacity = 4096,
+        OverflowPolicy overflow = OverflowPolicy::Block)
+        : queue(queueCapacity), policy(overflow),
+        sink(fileName, TransactionLogger::DurabilityMode::GroupCommit) {
+        writerThread = thread(&AsyncLogPipeline::writerLoop, this);
+    }
+
+    AsyncLogPipeline(const AsyncLogPipeline&) = delete;
+    AsyncLogPipeline& operator=(const AsyncLogPipeline&) = delete;
+
+    // Clean shutdown: every accepted record is written before the file closes
+    ~AsyncLogPipeline() {
+        stopping.store(true, memory_order_release);
+        wakeWriter.notify_one();
+        writerThread.join();
+    }
+
+    // Make a product's name and attributes available to the writer
+    void registerProduct(uint32_t id, RegisteredProduct product) {
+        lock_guard<mutex> lock(namesMutex);
+        if (products.size() <= id) products.resize(id + 1);
+        products[id] = product;
+    }
+
+    // Forget every registered product; call after drain() so no queued record
+    // still refers to one
+    void clearProducts() {
+        lock_guard<mutex> lock(namesMutex);
+        products.clear();
+    }
+
+    // Start mirroring every record into a write-ahead log. Call after drain()
+    // while no other thread is submitting, so the log starts at a clean boundary.
+    void attachWriteAheadLog(unique_ptr<WriteAheadLog> log) {
+        walOwner = move(log);
+        wal.store(walOwner.get(), memory_order_release);
+    }
+
+    // Forward every flushed WAL batch to `observer` (see WriteAheadLog::setFlushObserver);
+    // false if no WAL is attached
+    bool setWalFlushObserver(function<void(string_view, uint64_t)> observer) {
+        WriteAheadLog* log = wal.load(memory_order_acquire);
+        if (!log) return false;
+        log->setFlushObserver(move(observer));
+        return true;
+    }
+
+    // Ask the writer to drop WAL records already covered by a checkpoint
+    void requestWalCompaction(uint64_t through) {
+        compactThrough.store(through, memory_order_release);
+        wakeWriter.notify_one();
+    }
+
+    uint64_t getSubmittedCount() const { return submitted.load(memory_order_acquire); }
+
+    // Enqueue a record; returns false only if it was dropped under the Drop
+    // policy, which happens only while no write-ahead log is attached
+    bool submit(const LogRecord& record) {
+        while (!queue.tryPush(record)) {
+            if (policy == OverflowPolicy::Drop && !wal.load(memory_order_acquire)) {
+                dropped.fetch_add(1, memory_order_relaxed);
+                return false;
+            }
+            wakeWriter.notify_one();
+            this_thread::yield(); // Backpressure: wait for the writer to free a slot
+        }
+        submitted.fetch_add(1, memory_order_relaxed);
+        return true;
+    }
+
+    // Enqueue a group of records, claiming queue space once per chunk instead of once per record
+    size_t submitBatch(const LogRecord* records, size_t count) {
+        const size_t chunk = queue.capacity() / 2;
+        size_t accepted = 0;
+        while (accepted < count) {
+            size_t n = min(chunk, count - accepted);
+            while (!queue.tryPushBatch(records + accepted, n)) {
+                if (policy == OverflowPolicy::Drop && !wal.load(memory_order_acquire)) {
+                    dropped.fetch_add(count - accepted, memory_order_relaxed);
+                    submitted.fetch_add(accepted, memory_order_relaxed);
+                    return accepted;
+                }
+                wakeWriter.notify_one();
+                this_thread::yield();
+            }
+            accepted += n;
+        }
+        submitted.fetch_add(accepted, memory_order_relaxed);
+        return accepted;
+    }
+
+    // Block until everything submitted so far is formatted and flushed to disk
+    void drain() {
+        uint64_t target = submitted.load(memory_order_relaxed);
+        wakeWriter.notify_one();
+        unique_lock<mutex> lock(waitMutex);
+        drained.wait(lock, [&] { return written.load(memory_order_acquire) >= target; });
+    }
+
+    uint64_t getDroppedCount() const { return dropped.load(memory_order_relaxed); }
+
+    // Records submitted but not yet taken by the writer (approximate while threads are submitting)
+    uint64_t getQueueDepth() const {
+        uint64_t taken = consumed.load(memory_order_relaxed);
+        uint64_t total = submitted.load(memory_order_relaxed);
+        return total > taken ? total - taken : 0;
+    }
+};
+
+// Trim leading and trailing spaces from a field without copying it
+inline string_view trimField(string_view field) {
+    while (!field.empty() && (field.front() == ' ' || field.front() == '\t')) field.remove_prefix(1);
+    while (!field.empty() && (field.back() == ' ' || field.back() == '\t' || field.back() == '\r')) field.remove_suffix(1);
+    return field;
+}
+
+// Split a " | "-delimited record in place; returns the number of fields found.
+// A trailing empty field (from the closing " | ") is not counted.
+inline size_t splitRecordFields(string_view line, string_view* fields, size_t maxFields) {
+    size_t count = 0;
+    while (count < maxFields) {
+        size_t bar = line.find('|');
+        fields[count++] = trimField(line.substr(0, bar));
+        if (bar == string_view::npos) break;
+        line.remove_prefix(bar + 1);
+    }
+    if (count > 0 && fields[count - 1].empty()) --count;
+    return count;
+}
+
+// Parse a whole field as an integer; fails on trailing garbage
+inline bool parseIntField(string_view field, int& value) {
+    auto result = from_chars(field.data(), field.data() + field.size(), value);
+    return result.ec == errc() && result.ptr == field.data() + field.size();
+}
+
+// Parse a whole field as a double; fails on trailing garbage
+inline bool parseDoubleField(string_view field, double& value) {
+    auto result = from_chars(field.data(), field.data() + field.size(), value);
+    return result.ec == errc() && result.ptr == field.data() + field.size();
+}
+
+// Worker threads for bulk loads and saves (0 = one per hardware thread)
+inline unsigned parallelWorkers = 0;
+
+inline size_t parallelWorkerCount() {
+    return parallelWorkers ? parallelWorkers : max(1u, thread::hardware_concurrency());
+}
+
+// Run body(i) for every i in [0, count) on up to parallelWorkerCount() threads,
+// the calling thread included. Items are claimed one at a time, so uneven
+// items balance out; returns once every item has finished.
+template <typename Body>
+void parallelFor(size_t count, Body body) {
+    const size_t threads = min(parallelWorkerCount(), count);
+    if (threads <= 1) {
+        for (size_t i = 0; i < count; ++i) body(i);
+        return;
+    }
+    atomic<size_t> next{ 0 };
+    auto work = [&] {
+        for (size_t i = next.fetch_add(1, memory_order_relaxed); i < count; i = next.fetch_add(1, memory_order_relaxed)) body(i);
+    };
+    vector<thread> helpers;
+    helpers.reserve(threads - 1);
+    for (size_t t = 1; t < threads; ++t) helpers.emplace_back(work);
+    work();
+    for (thread& helper : helpers) helper.join();
+}
+
+// Sort on several threads: each sorts one slice, then neighbouring runs are
+// merged pairwise until one remains
+template <typename It, typename Less>
+void parallelSort(It first, It last, Less less) {
+    const size_t n = static_cast<size_t>(last - first);
+    size_t runs = 1;
+    while (runs * 2 <= parallelWorkerCount() && n / (runs * 2) >= 65536) runs *= 2;
+    if (runs == 1) {
+        sort(first, last, less);
+        return;
+    }
+    auto bound = [&](size_t run) { return first + static_cast<ptrdiff_t>(n * run / runs); };
+    parallelFor(runs, [&](size_t run) { sort(bound(run), bound(run + 1), less); });
+    for (size_t width = 1; width < runs; width *= 2) {
+        parallelFor(runs / (width * 2), [&](size_t pair) {
+            size_t run = pair * width * 2;
+            inplace_merge(bound(run), bound(run + width), bound(run + width * 2), less);
+        });
+    }
+}
+
+// Split a text image into about `parts` pieces that each end at a line break
+inline vector<string_view> splitAtLines(string_view contents, size_t parts) {
+    vector<string_view> pieces;
+    size_t start = 0;
+    for (size_t part = 1; part <= parts && start < contents.size(); ++part) {
+        size_t end = part == parts ? contents.size() : max(start, contents.size() * part / parts);
+        end = contents.find('\n', end);
+        end = end == string_view::npos ? contents.size() : end + 1;
+        pieces.push_back(contents.substr(start, end - start));
+        start = end;
+    }
+    return pieces;
+}
+
+// Scheduling class of a background task. Idle workers always take the highest
+// class queued anywhere in the pool first, so checkout-path work never waits
+// behind more than the slices already running.
+enum class TaskPriority : uint8_t {
+    High,   // Checkout path: reservation sweeps
+    Normal, // Durability: checkpoints, compaction
+    Low     // Batch: scans, autosaves, reports
+};
+
+inline constexpr size_t taskPriorityCount = 3;
+
+/*
+ * Work-stealing pool for the manager's background jobs.
+ * Each worker owns one deque per priority; it pops its own work LIFO and
+ * steals from the front of the others' deques when its own run dry. A timer
+ * thread hands delayed and periodic tasks to the pool when they fall due; a
+ * periodic task is re-armed only after a run finishes, so runs never overlap.
+ * Cancellation is cooperative: a cancelled task is dropped if it has not
+ * started, and long tasks poll their Handle between slices of work.
+ * Workers start on the first submission.
+ */
+class TaskScheduler {
+public:
+    using Clock = chrono::steady_clock;
+
+private:
+    // Bit flags of a task's lifecycle, waited on through atomic wait/notify
+    static constexpr uint32_t cancelledFlag = 1;
+    static constexpr uint32_t runningFlag = 2;
+    static constexpr uint32_t finishedFlag = 4;
+
+    struct TaskState {
+        atomic<uint32_t> flags{ 0 };
+    };
+
+    struct Job {
+        function<void()> run;
+        shared_ptr<TaskState> state;
+        Clock::duration period{}; // Zero for one-shot tasks
+        TaskPriority priority = TaskPriority::Normal;
+    };
+
+    struct alignas(64) Worker {
+        mutex lock;
+        deque<Job> queues[taskPriorityCount];
+    };
+
+    struct TimedJob {
+        Clock::time_point due;
+        uint64_t order; // Ties run in scheduling order
+        Job job;
+        bool operator>(const TimedJob& other) const {
+            return due != other.due ? due > other.due : order > other.order;
+        }
+    };
+
+    unique_ptr<Worker[]> workers;
+    size_t workerCount = 0;
+    vector<thread> threads;
+    atomic<size_t> pending{ 0 };     // Jobs sitting in worker deques
+    atomic<size_t> submitCursor{ 0 }; // Round-robin target for outside submissions
+    atomic<bool> stopping{ false };
+    mutex sleepMutex;
+    condition_variable wake;
+    once_flag startOnce;
+
+    mutex timerMutex;
+    condition_variable timerWake;
+    priority_queue<TimedJob, vector<TimedJob>, greater<TimedJob>> timers;
+    uint64_t timerOrder = 0;
+    thread timerThread;
+
+    // Worker index of the calling thread within currentScheduler
+    static inline thread_local const TaskScheduler* currentScheduler = nullptr;
+    static inline thread_local size_t currentWorker = 0;
+
+    static void markFinished(TaskState& state) {
+        state.flags.fetch_or(finishedFlag, memory_order_acq_rel);
+        state.flags.notify_all();
+    }
+
+    void start() {
+        call_once(startOnce, [this] {
+            workerCount = max<size_t>(1, parallelWorkerCount());
+            workers = make_unique<Worker[]>(workerCount);
+            threads.reserve(workerCount);
+            for (size_t i = 0; i < workerCount; ++i) threads.emplace_back(&TaskScheduler::workerLoop, this, i);
+            timerThread = thread(&TaskScheduler::timerLoop, this);
+        });
+    }
+
+    // Queue a job on the caller's own deque when it is a worker, otherwise round-robin
+    void enqueue(Job job) {
+        start();
+        if (stopping.load(memory_order_acquire)) {
+            markFinished(*job.state);
+            return;
+        }
+        size_t target = currentScheduler == this ? currentWorker : submitCursor.fetch_add(1, memory_order_relaxed) % workerCount;
+        {
+            lock_guard<mutex> lock(workers[target].lock);
+            workers[target].queues[static_cast<size_t>(job.priority)].push_back(move(job));
+        }
+        pending.fetch_add(1, memory_order_release);
+        {
+            lock_guard<mutex> lock(sleepMutex); // Pairs with the predicate check in workerLoop
+        }
+        wake.notify_one();
+    }
+
+    void arm(Clock::time_point due, Job job) {
+        start();
+        {
+            lock_guard<mutex> lock(timerMutex);
+            if (stopping.load(memory_order_relaxed)) {
+                markFinished(*job.state);
+                return;
+            }
+            timers.push(TimedJob{ due, timerOrder++, move(job) });
+        }
+        timerWake.notify_one();
+    }
+
+    // Take the highest-priority job visible to worker `self`: its own deque
+    // from the back, then the other workers' deques from the front
+    bool takeJob(size_t self, Job& job) {
+        for (size_t priority = 0; priority < taskPriorityCount; ++priority) {
+            for (size_t offset = 0; offset < workerCount; ++offset) {
+                Worker& worker = workers[(self + offset) % workerCount];
+                lock_guard<mutex> lock(worker.lock);
+                deque<Job>& queue = worker.queues[priority];
+                if (queue.empty()) continue;
+                if (offset == 0) {
+                    job = move(queue.back());
+                    queue.pop_back();
+                }
+                else {
+                    job = move(queue.front());
+                    queue.pop_front();
+                }
+                pending.fetch_sub(1, memory_order_relaxed);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void runJob(Job& job) {
+        const shared_ptr<TaskState> keep = job.state; // A re-armed job may finish and be dropped before the notify below
+        TaskState& state = *keep;
+        uint32_t flags = state.flags.load(memory_order_acquire);
+        do {
+            if (flags & cancelledFlag) {
+                markFinished(state);
+                return;
+            }
+        } while (!state.flags.compare_exchange_weak(flags, flags | runningFlag, memory_order_acq_rel));
+
+        job.run();
+
+        const bool again = job.period != Clock::duration::zero()
+            && !(state.flags.load(memory_order_acquire) & cancelledFlag) && !stopping.load(memory_order_acquire);
+        state.flags.fetch_and(~runningFlag, memory_order_acq_rel);
+        if (again) {
+            Clock::time_point due = Clock::now() + job.period;
+            arm(due, move(job));
+        }
+        else {
+            markFinished(state);
+        }
+        state.flags.notify_all();
+    }
+
+    void workerLoop(size_t self) {
+        currentScheduler = this;
+        currentWorker = self;
+        Job job;
+        while (true) {
+            if (takeJob(self, job)) {
+                runJob(job);
+                job = Job();
+                continue;
+            }
+            unique_lock<mutex> lock(sleepMutex);
+            wake.wait(lock, [this] { return stopping.load(memory_order_relaxed) || pending.load(memory_order_acquire) > 0; });
+            if (stopping.load(memory_order_relaxed)) return;
+        }
+    }
+
+    void timerLoop() {
+        unique_lock<mutex> lock(timerMutex);
+        while (!stopping.load(memory_order_relaxed)) {
+            if (timers.empty()) {
+                timerWake.wait(lock);
+                continue;
+            }
+            if (Clock::now() < timers.top().due) {
+                timerWake.wait_until(lock, timers.top().due);
+                continue;
+            }
+            Job job = move(const_cast<TimedJob&>(timers.top()).job);
+            timers.pop();
+            lock.unlock();
+            if (job.state->flags.load(memory_order_acquire) & cancelledFlag) markFinished(*job.state);
+            else enqueue(move(job));
+            lock.lock();
+        }
+    }
+
+public:
+    // Caller's view of a submitted task. A default-constructed handle refers to
+    // no task and counts as done.
+    class Handle {
+        shared_ptr<TaskState> state;
+        friend class TaskScheduler;
+
+    public:
+        Handle() = default;
+
+        // Ask the task to stop: it is dropped if it has not started, and a
+        // periodic task is not re-armed. A running task sees cancelled() turn true.
+        void cancel() const {
+            if (!state) return;
+            state->flags.fetch_or(cancelledFlag, memory_order_acq_rel);
+            state->flags.notify_all();
+        }
+
+        bool cancelled() const { return state && (state->flags.load(memory_order_acquire) & cancelledFlag); }
+
+        // True once the task will not run again
+        bool done() const {
+            if (!state) return true;
+            uint32_t flags = state->flags.load(memory_order_acquire);
+            return (flags & finishedFlag) || ((flags & cancelledFlag) && !(flags & runningFlag));
+        }
+
+        // Block until done(); a cancelled task only waits for a run in progress
+        void wait() const {
+            if (!state) return;
+            for (uint32_t flags = state->flags.load(memory_order_acquire);
+                !((flags & finishedFlag) || ((flags & cancelledFlag) && !(flags & runningFlag)));
+                flags = state->flags.load(memory_order_acquire)) {
+                state->flags.wait(flags, memory_order_acquire);
+            }
+        }
+    };
+
+    TaskScheduler() = default;
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+    ~TaskScheduler() { shutdown(); }
+
+    // Run a task once, as soon as a worker is free
+    Handle submit(TaskPriority priority, function<void()> task) {
+        return schedule(Clock::duration::zero(), Clock::duration::zero(), priority, move(task));
+    }
+
+    // Run a task once after `delay`, or every `period` after each run finishes
+    // when `period` is non-zero
+    Handle schedule(Clock::duration delay, Clock::duration period, TaskPriority priority, function<void()> task) {
+        Handle handle;
+        handle.state = make_shared<TaskState>();
+        Job job{ move(task), handle.state, period, priority };
+        if (delay <= Clock::duration::zero()) enqueue(move(job));
+        else arm(Clock::now() + delay, move(job));
+        return handle;
+    }
+
+    // Run a task every `period`, the first time one period from now
+    Handle schedulePeriodic(Clock::duration period, TaskPriority priority, function<void()> task) {
+        return schedule(period, period, priority, move(task));
+    }
+
+    // Run body(first, last) over [0, count) in slices of `grain` items, on the
+    // calling thread plus up to one pool task per worker at `priority`, and
+    // return once every slice has finished. While waiting the caller only runs
+    // slices of this range, so it may hold locks that other pool tasks need.
+    // Once `token` is cancelled the remaining slices are skipped.
+    template <typename Body>
+    void forEachRange(size_t count, size_t grain, TaskPriority priority, Body body, const Handle* token = nullptr) {
+        struct RangeState {
+            atomic<size_t> next{ 0 };
+            atomic<size_t> finished{ 0 };
+            size_t slices = 0;
+        };
+        grain = max<size_t>(1, grain);
+        auto range = make_shared<RangeState>();
+        range->slices = (count + grain - 1) / grain;
+        if (range->slices == 0) return;
+
+        // Helpers may start after the range is complete; they then find no slice
+        // left and never touch `body`, which lives on the caller's stack
+        auto work = [range, count, grain, &body, token] {
+            for (size_t slice = range->next.fetch_add(1, memory_order_relaxed); slice < range->slices;
+                slice = range->next.fetch_add(1, memory_order_relaxed)) {
+                if (!token || !token->cancelled()) body(slice * grain, min(count, (slice + 1) * grain));
+                if (range->finished.fetch_add(1, memory_order_acq_rel) + 1 == range->slices) range->finished.notify_all();
+            }
+        };
+        if (range->slices > 1) {
+            start();
+            for (size_t helper = 1; helper < min(range->slices, workerCount + 1); ++helper) submit(priority, work);
+        }
+        work();
+        for (size_t done = range->finished.load(memory_order_acquire); done < range->slices; done = range->finished.load(memory_order_acquire)) {
+            range->finished.wait(done, memory_order_acquire);
+        }
+    }
+
+    // Stop the pool: running tasks finish, queued and timed ones are dropped.
+    // Called by the destructor; the scheduler cannot be restarted.
+    void shutdown() {
+        {
+            lock_guard<mutex> lock(timerMutex);
+            if (stopping.exchange(true, memory_order_acq_rel)) return;
+        }
+        {
+            lock_guard<mutex> lock(sleepMutex);
+        }
+        wake.notify_all();
+        timerWake.notify_all();
+        call_once(startOnce, [] {}); // Never start once stopping
+        for (thread& worker : threads) worker.join();
+        if (timerThread.joinable()) timerThread.join();
+        for (size_t i = 0; i < workerCount; ++i) {
+            for (deque<Job>& queue : workers[i].queues) {
+                for (Job& job : queue) markFinished(*job.state);
+                queue.clear();
+            }
+        }
+        while (!timers.empty()) {
+            markFinished(*timers.top().job.state);
+            timers.pop();
+        }
+    }
+};
+
+// Replace a file crash-safely: write a temp file next to it, then rename it
+// over the target, so readers see either the old contents or the new ones.
+// The file is the concatenation of `pieces`, written in order.
+inline bool writeFileAtomically(const string& fileName, const vector<string_view>& pieces) {
+    string tempPath = fileName + ".tmp";
+    {
+        ofstream outFile(tempPath, ios::binary | ios::trunc);
+        for (string_view piece : pieces) outFile.write(piece.data(), static_cast<streamsize>(piece.size()));
+        if (!outFile) return false;
+    }
+    // Sync before the rename so a power loss cannot leave the target renamed but empty
+    if (!syncFile(tempPath)) return false;
+    error_code ec;
+    filesystem::rename(tempPath, fileName, ec);
+    if (ec) return false;
+    syncParentDirectory(fileName);
+    return true;
+}
+
+inline bool writeFileAtomically(const string& fileName, string_view contents) {
+    return writeFileAtomically(fileName, vector<string_view>{ contents });
+}
+
+/*
+ * Delta saves of the text inventory.
+ * A base file ("inventory.txt") holds full records and starts with a comment
+ * naming the last delta segment it already includes. Each later save writes
+ * only the changed records to a new numbered segment ("inventory.txt.delta.N").
+ * Loading applies the newer segments over the base in order, the last record
+ * for a name winning; compaction folds them into a fresh base.
+ */
+inline constexpr string_view deltaBaseHeader = "# Inventory base, includes delta segments through ";
+
+inline string deltaSegmentPath(const string& baseFile, uint64_t number) {
+    return baseFile + ".delta." + to_string(number);
+}
+
+// Numbers of the delta segments of a base file present on disk, ascending
+inline vector<uint64_t> listDeltaSegments(const string& baseFile) {
+    vector<uint64_t> numbers;
+    filesystem::path base(baseFile);
+    filesystem::path directory = base.has_parent_path() ? base.parent_path() : filesystem::path(".");
+    const string prefix = base.filename().string() + ".delta.";
+    error_code ec;
+    for (filesystem::directory_iterator it(directory, ec), end; !ec && it != end; it.increment(ec)) {
+        string name = it->path().filename().string();
+        if (name.size() <= prefix.size() || name.compare(0, prefix.size(), prefix) != 0) continue;
+        uint64_t number = 0;
+        const char* first = name.data() + prefix.size();
+        const char* last = name.data() + name.size();
+        auto result = from_chars(first, last, number);
+        if (result.ec == errc() && result.ptr == last) numbers.push_back(number); // Skips ".tmp" leftovers
+    }
+    sort(numbers.begin(), numbers.end());
+    return numbers;
+}
+
+// Last segment folded into a base file (0 for files without the header)
+inline uint64_t deltaBaseThrough(string_view contents) {
+    if (contents.substr(0, deltaBaseHeader.size()) != deltaBaseHeader) return 0;
+    uint64_t through = 0;
+    from_chars(contents.data() + deltaBaseHeader.size(), contents.data() + contents.size(), through);
+    return through;
+}
+
+// Merge the base file with its segments up to `through` into a new base, then
+// delete those segments. Works on the files alone, so it can run beside the
+// catalog; a crash at any point leaves a set of files that loads the same.
+inline bool compactInventoryDeltas(const string& baseFile, uint64_t through) {
+    string base;
+    if (!readWholeFile(baseFile, base)) return false;
+    const uint64_t baseThrough = deltaBaseThrough(base);
+
+    vector<string> segments;
+    vector<uint64_t> merged;
+    for (uint64_t number : listDeltaSegments(baseFile)) {
+        if (number <= baseThrough || number > through) continue;
+        segments.emplace_back();
+        if (!readWholeFile(deltaSegmentPath(baseFile, number), segments.back())) return false;
+        merged.push_back(number);
+    }
+
+    // Later records for a name replace earlier ones in place; new names are appended
+    vector<string_view> records;
+    unordered_map<string_view, size_t> byName;
+    auto addRecords = [&](string_view contents) {
+        while (!contents.empty()) {
+            size_t eol = contents.find('\n');
+            string_view line = contents.substr(0, eol);
+            contents.remove_prefix(eol == string_view::npos ? contents.size() : eol + 1);
+            string_view name;
+            if (line.substr(0, deltaBaseHeader.size()) == deltaBaseHeader || splitRecordFields(line, &name, 1) == 0) continue;
+            auto [it, inserted] = byName.emplace(name, records.size());
+            if (inserted) records.push_back(line);
+            else records[it->second] = line;
+        }
+    };
+    addRecords(base);
+    for (const string& segment : segments) addRecords(segment);
+
+    string image = string(deltaBaseHeader) + to_string(max(through, baseThrough)) + "\n";
+    size_t bytes = image.size();
+    for (string_view line : records) bytes += line.size() + 1;
+    image.reserve(bytes);
+    for (string_view line : records) {
+        image += line;
+        image += '\n';
+    }
+    if (!writeFileAtomically(baseFile, image)) return false;
+    inventoryMetrics.addBytes(MetricSink::InventoryFile, image.size());
+
+    error_code ec;
+    for (uint64_t number : merged) filesystem::remove(deltaSegmentPath(baseFile, number), ec);
+    return true;
+}
+
+/*
+ * Binary inventory snapshot layout (little-endian, position independent so the
+ * file can be memory-mapped and read in place):
+ *   SnapshotHeader
+ *   SnapshotRecord[recordCount]   fixed-width numeric fields, in product id order
+ *   string table                  names and expiration dates, referenced by offset
+ * The checksum covers everything after the header.
+ */
+const char snapshotMagic[4] = { 'I', 'N', 'V', 'S' };
+const uint16_t snapshotVersion = 2;
+
+// Version 1 headers end after `reserved` (24 bytes); version 2 adds the last
+// write-ahead log sequence number the snapshot includes (0 if unrelated to a log).
+struct SnapshotHeader {
+    char magic[4];
+    uint16_t version;
+    uint16_t headerSize;
+    uint32_t recordCount;
+    uint32_t stringTableSize;
+    uint32_t checksum;
+    uint32_t reserved;
+    uint64_t lastSequence;
+};
+
+const size_t snapshotHeaderSizeV1 = 24;
+
+struct SnapshotRecord {
+    double price;
+    uint32_t nameOffset;   // Offset into the string table
+    uint32_t detailOffset; // The type's Text or Date field (string table offset)
+    int32_t stock;
+    int32_t integerField;  // The type's Integer field (warranty months for Electronics)
+    uint16_t nameLength;
+    uint16_t detailLength;
+    uint8_t type;          // ProductTypeTag
+    uint8_t padding[3];
+};
+
+static_assert(sizeof(SnapshotHeader) == 32, "Snapshot header layout changed");
+static_assert(sizeof(SnapshotRecord) == 32, "Snapshot record layout changed");
+
+/*
+ * Open-addressing hash index from product name to dense product id.
+ * Each name is interned once in the catalog arena; the table itself is a flat array of
+ * (hash tag, id) slots probed linearly, so a lookup is one hash plus a
+ * short scan of contiguous memory instead of a tree walk.
+ */
+class ProductIndex {
+public:
+    static constexpr uint32_t npos = UINT32_MAX;
+
+private:
+    struct Slot {
+        uint32_t hashTag; // Upper bits of the hash, checked before comparing names
+        uint32_t id;      // npos when the slot is empty
+    };
+
+    CatalogArena& arena;  // Owns the name characters
+    vector<Slot> slots;
+    vector<string_view> names; // Interned names indexed by id
+    size_t mask = 0;
+
+    // Double the table and reinsert every id (names are already interned)
+    void grow() {
+        size_t capacity = slots.empty() ? 16 : slots.size() * 2;
+        vector<Slot> old(capacity, Slot{ 0, npos });
+        old.swap(slots);
+        mask = capacity - 1;
+        for (const Slot& slot : old) {
+            if (slot.id == npos) continue;
+            size_t pos = hashName(names[slot.id]) & mask;
+            while (slots[pos].id != npos) pos = (pos + 1) & mask;
+            slots[pos] = slot;
+        }
+    }
+
+public:
+    explicit ProductIndex(CatalogArena& storage) : arena(storage) {}
+
+    // 64-bit FNV-1a hash of a name. Public so bulk loads can hash on their
+    // parsing threads and hand the result to insert().
+    static uint64_t hashName(string_view name) {
+        uint64_t hash = 14695981039346656037ull;
+        for (char c : name) {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    // Preallocate room for a known number of names
+    void reserve(size_t count) {
+        names.reserve(count);
+        while (slots.size() < count * 2) grow();
+    }
+
+    // Return the id for a name, or npos if it has not been interned
+    uint32_t find(string_view name) const {
+        if (slots.empty()) return npos;
+        uint64_t hash = hashName(name);
+        uint32_t tag = static_cast<uint32_t>(hash >> 32);
+        for (size_t pos = hash & mask; slots[pos].id != npos; pos = (pos + 1) & mask) {
+            if (slots[pos].hashTag == tag && names[slots[pos].id] == name) return slots[pos].id;
+        }
+        return npos;
+    }
+
+    // Start pulling the home slot of a hash into cache ahead of insert()
+    void prefetch(uint64_t hash) const {
+        if (!slots.empty()) INVENTORY_PREFETCH(&slots[hash & mask]);
+    }
+
+    // Intern a new name and return its id; returns npos if the name already exists
+    uint32_t insert(string_view name) {
+        return insert(name, hashName(name));
+    }
+
+    // insert() with the name's hashName() already computed
+    uint32_t insert(string_view name, uint64_t hash) {
+        if ((names.size() + 1) * 2 > slots.size()) grow(); // Keep load factor at or below 1/2
+        uint32_t tag = static_cast<uint32_t>(hash >> 32);
+        size_t pos = hash & mask;
+        for (; slots[pos].id != npos; pos = (pos + 1) & mask) {
+            if (slots[pos].hashTag == tag && names[slots[pos].id] == name) return npos;
+        }
+        uint32_t id = static_cast<uint32_t>(names.size());
+        names.push_back(arena.intern(name));
+        slots[pos] = Slot{ tag, id };
+        return id;
+    }
+
+    // Ids ordered by name, built on demand for listings and saves
+    vector<uint32_t> sortedIds() const {
+        vector<uint32_t> ids(names.size());
+        for (uint32_t i = 0; i < ids.size(); ++i) ids[i] = i;
+        parallelSort(ids.begin(), ids.end(), [this](uint32_t a, uint32_t b) { return names[a] < names[b]; });
+        return ids;
+    }
+
+    // Forget every name (the arena owns the strings and is cleared separately)
+    void clear() {
+        names.clear();
+        slots.clear();
+        mask = 0;
+    }
+
+    string_view nameOf(uint32_t id) const { return names[id]; }
+    size_t size() const { return names.size(); }
+    bool empty() const { return names.empty(); }
+};
+
+// One inventory.txt record, tokenized in place
+struct ParsedRecord {
+    string_view name;
+    string_view textField;  // The type's Text or Date field, if any
+    uint64_t nameHash = 0;  // ProductIndex::hashName(name), computed by the parsing thread
+    double price = 0.0;
+    int stock = 0;
+    int integerField = 0;   // The type's Integer field, if any
+    ProductTypeTag type = ProductTypeTag::Electronics;
+};
+
+// Read the declared fields of `Type` from `values` in record order into the
+// integer and text slots. Missing trailing fields keep their defaults; false
+// if an Integer field is not a number or a text field is too long to store.
+template <typename Type>
+bool parseTypeFields(const string_view* values, size_t count, int& integer, string_view& text) {
+    for (size_t i = 0; i < Type::fields.size() && i < count; ++i) {
+        if (Type::fields[i].kind != FieldKind::Integer) {
+            if (values[i].size() > maxStoredStringLength) return false;
+            text = values[i];
+        }
+        else if (!parseIntField(values[i], integer)) return false;
+    }
+    return true;
+}
+
+// parseTypeFields() for a type known only at run time
+inline bool parseProductFields(ProductTypeTag type, const string_view* values, size_t count, int& integer, string_view& text) {
+    return ProductTypes::dispatch(type, [&](auto declared) {
+        return parseTypeFields<typename decltype(declared)::type>(values, count, integer, text);
+    });
+}
+
+// Tokenize one record; false for blank or malformed lines. Records are
+// "Name | Type | Stock | Price | Fields... |" with the type's declared fields
+// in order (the warranty for Electronics, the expiration date for Food); the
+// price and the fields are optional so older files still load.
+inline bool parseInventoryRecord(string_view line, ParsedRecord& record) {
+    string_view fields[4 + ProductTypes::maxFields];
+    size_t count = splitRecordFields(line, fields, 4 + ProductTypes::maxFields);
+    if (count < 3 || fields[0].empty() || fields[0].size() > maxStoredStringLength || !parseIntField(fields[2], record.stock) || record.stock < 0) return false;
+    if (count >= 4 && !parseDoubleField(fields[3], record.price)) return false;
+    if (!ProductTypes::parse(fields[1], record.type)) return false;
+    if (count > 4 && !parseProductFields(record.type, fields + 4, count - 4, record.integerField, record.textField)) return false;
+    record.name = fields[0];
+    record.nameHash = ProductIndex::hashName(record.name);
+    return true;
+}
+
+// Tokenize a whole inventory file image on the worker pool. Large images are
+// cut into several chunks per worker at line breaks; the chunks come back in
+// file order, so duplicate names resolve exactly as in a serial load.
+inline vector<vector<ParsedRecord>> parseInventoryRecords(string_view contents) {
+    const size_t parts = contents.size() >= (1 << 20) ? parallelWorkerCount() * 4 : 1;
+    vector<string_view> pieces = splitAtLines(contents, parts);
+    vector<vector<ParsedRecord>> chunks(pieces.size());
+    parallelFor(pieces.size(), [&](size_t i) {
+        string_view rest = pieces[i];
+        chunks[i].reserve(static_cast<size_t>(count(rest.begin(), rest.end(), '\n')) + 1);
+        ParsedRecord record;
+        while (!rest.empty()) {
+            size_t eol = rest.find('\n');
+            string_view line = rest.substr(0, eol);
+            rest.remove_prefix(eol == string_view::npos ? rest.size() : eol + 1);
+            record = ParsedRecord();
+            if (parseInventoryRecord(line, record)) chunks[i].push_back(record);
+        }
+    });
+    return chunks;
+}
+
+/*
+ * Case-insensitive name search over a ProductIndex.
+ * Prefix queries binary-search an array of ids sorted by folded name; fuzzy
+ * queries gather candidates from trigram posting lists and verify them with a
+ * bounded edit distance. Inserts are O(1) appends; the sorted array and the
+ * posting lists catch up on the next query, so bulk loads pay one sort.
+ * Inserts require exclusive access to the catalog; queries may run
+ * concurrently and serialize only while catching up.
+ */
+class NameSearchIndex {
+private:
+    const ProductIndex& names;
+    // Query-side caches, brought up to date by refresh()
+    mutable vector<uint32_t> sorted;  // Ids ordered by folded name
+    mutable vector<uint32_t> pending; // Ids added since the last merge into `sorted`
+    mutable unordered_map<uint32_t, vector<uint32_t>> postings; // Trigram -> ids containing it
+    mutable size_t trigramsIndexed = 0; // Ids [0, trigramsIndexed) are in `postings`
+    mutable atomic<bool> stale{ false };
+    mutable mutex refreshMutex;
+
+    static char fold(char c) { return (c >= 'A' && c <= 'Z') ? static_cast<char>(c + ('a' - 'A')) : c; }
+
+    // Case-insensitive three-way comparison
+    static int foldedCompare(string_view a, string_view b) {
+        size_t n = min(a.size(), b.size());
+        for (size_t i = 0; i < n; ++i) {
+            unsigned char x = static_cast<unsigned char>(fold(a[i])), y = static_cast<unsigned char>(fold(b[i]));
+            if (x != y) return x < y ? -1 : 1;
+        }
+        return a.size() == b.size() ? 0 : (a.size() < b.size() ? -1 : 1);
+    }
+
+    // Case-insensitive ordering, ties broken by the raw bytes so the order is total
+    static bool foldedLess(string_view a, string_view b) {
+        int order = foldedCompare(a, b);
+        return order < 0 || (order == 0 && a < b);
+    }
+
+    static bool foldedStartsWith(string_view name, string_view prefix) {
+        if (name.size() < prefix.size()) return false;
+        for (size_t i = 0; i < prefix.size(); ++i) {
+            if (fold(name[i]) != fold(prefix[i])) return false;
+        }
+        return true;
+    }
+
+    // Distinct folded trigrams of a name, with a start marker so short names still have some
+    static void trigramsOf(string_view name, vector<uint32_t>& out) {
+        out.clear();
+        uint32_t window = 1; // Start marker
+        for (size_t i = 0; i < name.size(); ++i) {
+            window = ((window << 8) | static_cast<unsigned char>(fold(name[i]))) & 0xFFFFFF;
+            if (i >= 1) out.push_back(window);
+        }
+        sort(out.begin(), out.end());
+        out.erase(unique(out.begin(), out.end()), out.end());
+    }
+
+    // Optimal-string-alignment distance between folded strings, or limit + 1 once it exceeds limit
+    static size_t editDistance(string_view a, string_view b, size_t limit) {
+        if (a.size() > b.size() + limit || b.size() > a.size() + limit) return limit + 1;
+        vector<size_t> previous2(b.size() + 1), previous(b.size() + 1), current(b.size() + 1);
+        for (size_t j = 0; j <= b.size(); ++j) previous[j] = j;
+        for (size_t i = 1; i <= a.size(); ++i) {
+            current[0] = i;
+            size_t rowMin = i;
+            for (size_t j = 1; j <= b.size(); ++j) {
+                size_t cost = fold(a[i - 1]) == fold(b[j - 1]) ? 0 : 1;
+                current[j] = min({ previous[j] + 1, current[j - 1] + 1, previous[j - 1] + cost });
+                if (i > 1 && j > 1 && fold(a[i - 1]) == fold(b[j - 2]) && fold(a[i - 2]) == fold(b[j - 1])) {
+                    current[j] = min(current[j], previous2[j - 2] + 1);
+                }
+                rowMin = min(rowMin, current[j]);
+            }
+            if (rowMin > limit) return limit + 1;
+            swap(previous2, previous);
+            swap(previous, current);
+        }
+        return min(previous[b.size()], limit + 1);
+    }
+
+    // Merge pending ids into the sorted array and index their trigrams
+    void refresh() const {
+        if (!stale.load(memory_order_acquire)) return;
+        lock_guard<mutex> lock(refreshMutex);
+        if (!stale.load(memory_order_relaxed)) return;
+        auto byName = [this](uint32_t a, uint32_t b) { return foldedLess(names.nameOf(a), names.nameOf(b)); };
+        sort(pending.begin(), pending.end(), byName);
+        size_t middle = sorted.size();
+        sorted.insert(sorted.end(), pending.begin(), pending.end());
+        inplace_merge(sorted.begin(), sorted.begin() + middle, sorted.end(), byName);
+        pending.clear();
+
+        vector<uint32_t> grams;
+        for (; trigramsIndexed < names.size(); ++trigramsIndexed) {
+            uint32_t id = static_cast<uint32_t>(trigramsIndexed);
+            trigramsOf(names.nameOf(id), grams);
+            for (uint32_t gram : grams) postings[gram].push_back(id);
+        }
+        stale.store(false, memory_order_release);
+    }
+
+public:
+    explicit NameSearchIndex(const ProductIndex& index) : names(index) {}
+
+    // Register a newly interned id (ids arrive in increasing order)
+    void insert(uint32_t id) {
+        pending.push_back(id);
+        stale.store(true, memory_order_release);
+    }
+
+    // Forget every id; call when the name index is cleared
+    void clear() {
+        lock_guard<mutex> lock(refreshMutex);
+        sorted.clear();
+        pending.clear();
+        postings.clear();
+        trigramsIndexed = 0;
+        stale.store(false, memory_order_release);
+    }
+
+    // Ids whose names start with `prefix` (ignoring case), in name order
+    vector<uint32_t> findPrefix(string_view prefix, size_t limit) const {
+        refresh();
+        vector<uint32_t> ids;
+        auto it = lower_bound(sorted.begin(), sorted.end(), prefix,
+            [this](uint32_t id, string_view key) { return foldedCompare(names.nameOf(id), key) < 0; });
+        for (; it != sorted.end() && ids.size() < limit && foldedStartsWith(names.nameOf(*it), prefix); ++it) {
+            ids.push_back(*it);
+        }
+        return ids;
+    }
+
+    // Ids whose names are within a small edit distance of `query` (1 edit for
+    // short queries, 2 otherwise), closest first
+    vector<uint32_t> findSimilar(string_view query, size_t limit) const {
+        refresh();
+        vector<uint32_t> grams;
+        trigramsOf(query, grams);
+        const size_t maxEdits = query.size() <= 4 ? 1 : 2;
+        // Each edit destroys at most three trigrams, so a match keeps at least this many
+        const size_t required = grams.size() > 3 * maxEdits ? grams.size() - 3 * maxEdits : 1;
+
+        thread_local vector<uint16_t> counts;
+        thread_local vector<uint32_t> touched;
+        counts.resize(max(counts.size(), names.size()));
+        touched.clear();
+        for (uint32_t gram : grams) {
+            auto list = postings.find(gram);
+            if (list == postings.end()) continue;
+            for (uint32_t id : list->second) {
+                if (counts[id]++ == 0) touched.push_back(id);
+            }
+        }
+
+        vector<pair<size_t, uint32_t>> matches; // (distance, id)
+        for (uint32_t id : touched) {
+            if (counts[id] >= required) {
+                size_t distance = editDistance(query, names.nameOf(id), maxEdits);
+                if (distance <= maxEdits) matches.emplace_back(distance, id);
+            }
+            counts[id] = 0;
+        }
+        sort(matches.begin(), matches.end(), [this](const pair<size_t, uint32_t>& a, const pair<size_t, uint32_t>& b) {
+            if (a.first != b.first) return a.first < b.first;
+            return foldedLess(names.nameOf(a.second), names.nameOf(b.second));
+        });
+        vector<uint32_t> ids;
+        for (size_t i = 0; i < matches.size() && i < limit; ++i) ids.push_back(matches[i].second);
+        return ids;
+    }
+};
+
+/*
+ * Calendar index of expiry dates (every type with a Date field).
+ * Product ids are bucketed by expiry day in an ordered map, so range queries
+ * and expiry sweeps visit only the matching buckets (O(log days + k)) instead
+ * of scanning every row. Dates never change, so each id is inserted once.
+ */
+class ExpiryIndex {
+private:
+    map<int32_t, vector<uint32_t>> buckets; // Expiry day -> product ids
+    size_t entries = 0;
+
+public:
+    void insert(int32_t day, uint32_t id) {
+        buckets[day].push_back(id);
+        ++entries;
+    }
+
+    // Call visit(id, day) for every id expiring in [fromDay, toDay], earliest first
+    template <typename Visitor>
+    void forEachBetween(int32_t fromDay, int32_t toDay, Visitor visit) const {
+        for (auto it = buckets.lower_bound(fromDay); it != buckets.end() && it->first <= toDay; ++it) {
+            for (uint32_t id : it->second) visit(id, it->first);
+        }
+    }
+
+    void clear() {
+        buckets.clear();
+        entries = 0;
+    }
+
+    size_t size() const { return entries; }
+};
+
+/*
+ * Sharded reader/writer lock guarding the catalog structure.
+ * Each thread takes the shared side of its own shard, so concurrent sales
+ * never contend on one lock word; structural changes (adding products,
+ * column-wide passes) take every shard exclusively. Per-row stock and price
+ * updates run under the shared side and rely on atomic CAS instead.
+ */
+class ShardedLock {
+private:
+    static constexpr size_t shardCount = 64;
+
+    struct alignas(64) Shard {
+        shared_mutex mutex;
+    };
+
+    Shard shards[shardCount];
+
+    // Each thread sticks to one shard, assigned round-robin on first use
+    static size_t threadShard() {
+        static atomic<size_t> nextShard{ 0 };
+        thread_local size_t shard = nextShard.fetch_add(1, memory_order_relaxed) % shardCount;
+        return shard;
+    }
+
+public:
+    // RAII shared access for point operations
+    class SharedGuard {
+    private:
+        shared_mutex& mutex;
+    public:
+        explicit SharedGuard(ShardedLock& lock) : mutex(lock.shards[threadShard()].mutex) { mutex.lock_shared(); }
+        ~SharedGuard() { mutex.unlock_shared(); }
+        SharedGuard(const SharedGuard&) = delete;
+        SharedGuard& operator=(const SharedGuard&) = delete;
+    };
+
+    // RAII exclusive access to the whole catalog (shards locked in a fixed order)
+    class ExclusiveGuard {
+    private:
+        ShardedLock& lock;
+    public:
+        explicit ExclusiveGuard(ShardedLock& owner) : lock(owner) {
+            for (Shard& shard : lock.shards) shard.mutex.lock();
+        }
+        ~ExclusiveGuard() {
+            for (size_t i = shardCount; i-- > 0;) lock.shards[i].mutex.unlock();
+        }
+        ExclusiveGuard(const ExclusiveGuard&) = delete;
+        ExclusiveGuard& operator=(const ExclusiveGuard&) = delete;
+    };
+};
+
+/*
+ * Lock-free table of outstanding stock reservations.
+ * A reservation has already taken its units out of the stock column; it is
+ * either committed (the sale goes through), released (units go back) or
+ * reclaimed once its deadline passes. Slot states are packed into their own
+ * array as (generation << 2 | status) so claiming, finishing and sweeping
+ * are single CAS operations and a sweep only reads 8 bytes per slot.
+ */
+class ReservationTable {
+public:
+    // Identifies one reservation; generation 0 means "no reservation"
+    struct Handle {
+        uint32_t slot = 0;
+        uint32_t generation = 0;
+        bool valid() const { return generation != 0; }
+    };
+
+    // What a finished reservation held, so the caller can log or restore it
+    struct Entry {
+        uint32_t productId;
+        int32_t quantity;
+    };
+
+private:
+    enum : uint64_t { Free = 0, Claiming = 1, Held = 2 };
+
+    size_t capacity;
+    unique_ptr<atomic<uint64_t>[]> states;
+    unique_ptr<atomic<uint32_t>[]> productIds;
+    unique_ptr<atomic<int32_t>[]> quantities;
+    unique_ptr<atomic<int64_t>[]> deadlines; // steady_clock nanoseconds
+    atomic<size_t> outstanding{ 0 };
+
+    static uint64_t pack(uint64_t generation, uint64_t status) { return (generation << 2) | status; }
+
+    // Move a held slot back to Free if it still has the expected generation
+    bool finish(uint32_t slot, uint32_t generation, Entry& entry) {
+        entry.productId = productIds[slot].load(memory_order_relaxed);
+        entry.quantity = quantities[slot].load(memory_order_relaxed);
+        uint64_t expected = pack(generation, Held);
+        if (!states[slot].compare_exchange_strong(expected, pack(generation, Free), memory_order_acq_rel)) {
+            return false; // Already committed, released or reclaimed
+        }
+        outstanding.fetch_sub(1, memory_order_relaxed);
+        return true;
+    }
+
+public:
+    explicit ReservationTable(size_t slots = 65536)
+        : capacity(slots), states(new atomic<uint64_t>[slots]), productIds(new atomic<uint32_t>[slots]),
+        quantities(new atomic<int32_t>[slots]), deadlines(new atomic<int64_t>[slots]) {
+        for (size_t i = 0; i < capacity; ++i) states[i].store(pack(0, Free), memory_order_relaxed);
+    }
+
+    // Claim a free slot for units that were already taken from stock.
+    // Returns an invalid handle if every slot is in use.
+    Handle insert(uint32_t productId, int32_t quantity, int64_t deadlineNs) {
+        thread_local size_t cursor = 0;
+        for (size_t probe = 0; probe < capacity; ++probe) {
+            size_t slot = (cursor + probe) % capacity;
+            uint64_t state = states[slot].load(memory_order_relaxed);
+            if ((state & 3) != Free) continue;
+            uint64_t generation = ((state >> 2) + 1) & 0xFFFFFFFFu;
+            if (generation == 0) generation = 1;
+            if (!states[slot].compare_exchange_strong(state, pack(generation, Claiming), memory_order_acquire)) continue;
+
+            productIds[slot].store(productId, memory_order_relaxed);
+            quantities[slot].store(quantity, memory_order_relaxed);
+            deadlines[slot].store(deadlineNs, memory_order_relaxed);
+            states[slot].store(pack(generation, Held), memory_order_release);
+            outstanding.fetch_add(1, memory_order_relaxed);
+            cursor = slot + 1;
+            return Handle{ static_cast<uint32_t>(slot), static_cast<uint32_t>(generation) };
+        }
+        return Handle();
+    }
+
+    // Finish a reservation; false if the handle is stale (already finished or reclaimed)
+    bool take(Handle handle, Entry& entry) {
+        if (!handle.valid() || handle.slot >= capacity) return false;
+        return finish(handle.slot, handle.generation, entry);
+    }
+
+    // Free every reservation whose deadline has passed and hand each one to `onExpired`.
+    // Returns immediately when nothing is outstanding.
+    template <typename Callback>
+    size_t reclaimExpired(int64_t nowNs, Callback onExpired) {
+        if (outstanding.load(memory_order_relaxed) == 0) return 0;
+        size_t reclaimed = 0;
+        for (size_t slot = 0; slot < capacity; ++slot) {
+            uint64_t state = states[slot].load(memory_order_acquire);
+            if ((state & 3) != Held || deadlines[slot].load(memory_order_relaxed) > nowNs) continue;
+            Entry entry;
+            if (finish(static_cast<uint32_t>(slot), static_cast<uint32_t>(state >> 2), entry)) {
+                onExpired(entry);
+                ++reclaimed;
+            }
+        }
+        return reclaimed;
+    }
+
+    // Visit every held reservation; the caller must stop commits and releases meanwhile
+    template <typename Callback>
+    void forEachHeld(Callback visit) const {
+        if (outstanding.load(memory_order_relaxed) == 0) return;
+        for (size_t slot = 0; slot < capacity; ++slot) {
+            if ((states[slot].load(memory_order_acquire) & 3) != Held) continue;
+            visit(Entry{ productIds[slot].load(memory_order_relaxed), quantities[slot].load(memory_order_relaxed) });
+        }
+    }
+
+    size_t outstandingCount() const { return outstanding.load(memory_order_relaxed); }
+};
+
+// Which products displayInventory lists, and which page of the matches to show
+struct DisplayOptions {
+    bool filterByType = false;
+    ProductTypeTag type = ProductTypeTag::Electronics;
+    int stockBelow = INT_MAX; // Only products with less stock than this
+    string prefix;            // Only names starting with this
+    size_t offset = 0;        // Matches to skip before the first one shown
+    size_t limit = SIZE_MAX;  // Maximum number of products shown
+};
+
+// One line of a batch of inventory operations
+struct InventoryOperation {
+    enum class Kind : uint8_t { Sell, Restock, Discount };
+
+    Kind kind;
+    uint32_t productId;
+    int quantity = 0;        // Units for Sell and Restock
+    double percentage = 0.0; // Percentage for Discount
+};
+
+// Outcome of applyBatch: either every operation was applied or none was
+struct BatchResult {
+    bool applied = false;
+    size_t failedIndex = 0; // Index of the first operation that could not be applied
+    string error;
+};
+
+// Manages inventory of products
+class InventoryManager {
+private:
+    CatalogArena arena; // Owns the product façades and every catalog string; declared first so it outlives the log writer
+    ProductIndex index{ arena }; // Interned product names -> dense product ids
+    vector<Product*> productsById; // Dense product id -> façade in the arena
+    ProductStore store; // Columnar stock/price/type data indexed by product id
+    ExpiryIndex expiryIndex; // Ids of products with a Date field, bucketed by expiry day
+    NameSearchIndex nameSearch{ index }; // Prefix and typo-tolerant lookups
+    const int restockAmount = 10; // Amount checkAndRestock adds to each low item
+    ReplenishmentPolicy defaultPolicy; // Given to products added without a policy
+    mutex replenishMutex;               // Serializes replenish passes
+    mutable AsyncLogPipeline logPipeline; // Background writer for transaction_log.txt
+    mutable ShardedLock catalogLock; // Shared for point operations, exclusive for structural changes
+    ReservationTable reservations; // Units held by checkouts that have not completed yet
+
+    // Write-ahead log and checkpoint state (inactive until enableDurableLog)
+    string checkpointPath;
+    string metricsPath; // Text exposition file rewritten after each checkpoint (empty = off)
+    uint64_t walBaseSequence = 1;  // Sequence number of the first record after recovery
+    uint64_t walBaseSubmitted = 0; // Pipeline submission count at that point
+    TaskScheduler::Handle checkpointJob;
+
+    // Delta saves of the text inventory (see saveInventoryToFile)
+    static constexpr size_t compactAfterSegments = 8;
+    mutex saveMutex;                    // Serializes text saves and loads
+    string deltaBasePath;               // Base file the dirty bits are relative to (empty = next save is full)
+    uint64_t nextSegment = 1;           // Number of the next delta segment
+    size_t segmentsSinceCompaction = 0;
+    TaskScheduler::Handle compactionJob;
+
+    // Background jobs (see startMaintenance); declared last so it stops first
+    vector<TaskScheduler::Handle> maintenanceJobs;
+    TaskScheduler scheduler;
+
+    // Add a product from its fields; caller holds the catalog exclusively.
+    // Returns the new façade, or nullptr if the name is already taken or the
+    // name or text field is longer than maxStoredStringLength.
+    Product* addProductLocked(ProductTypeTag type, string_view name, double price, int stock, int integer, string_view text) {
+        return addProductLocked(type, name, ProductIndex::hashName(name), price, stock, integer, text);
+    }
+
+    // addProductLocked() with the name's ProductIndex::hashName() already computed
+    Product* addProductLocked(ProductTypeTag type, string_view name, uint64_t nameHash, double price, int stock, int integer, string_view text) {
+        if (!ProductTypes::isKnown(static_cast<uint8_t>(type))) {
+            cout << "Unknown product type for '" << name << "'. Skipping...\n";
+            return nullptr;
+        }
+        if (name.size() > maxStoredStringLength || text.size() > maxStoredStringLength) {
+            cout << "Product name or field of '" << name.substr(0, 40) << "...' is longer than "
+                << maxStoredStringLength << " characters. Skipping...\n";
+            return nullptr;
+        }
+        uint32_t id = index.insert(name, nameHash);
+        if (id == ProductIndex::npos) {
+            cout << "Product with name '" << name << "' already exists. Skipping...\n";
+            return nullptr;
+        }
+        string_view storedName = index.nameOf(id);
+        string_view storedText;
+        Product* product = ProductTypes::dispatch(type, [&](auto declared) -> Product* {
+            using Type = typename decltype(declared)::type;
+            // Slots the type does not declare stay empty, whatever the caller passed
+            if constexpr (FieldSlots<Type>::integer == FieldSlots<Type>::none) integer = 0;
+            if constexpr (FieldSlots<Type>::text != FieldSlots<Type>::none) storedText = arena.intern(text);
+            store.append(type, storedName, price, stock, integer, storedText);
+            return arena.create<typename Type::Facade>(&store, id);
+        });
+        if (store.getExpiryDate(id) != invalidDate) expiryIndex.insert(store.getExpiryDate(id), id);
+        nameSearch.insert(id);
+        if (defaultPolicy.rule != ReorderRule::None) store.setPolicy(id, defaultPolicy);
+        productsById.push_back(product);
+
+        RegisteredProduct registered;
+        registered.name = storedName;
+        registered.type = type;
+        registered.integerField = integer;
+        registered.textField = storedText;
+        logPipeline.registerProduct(id, registered);
+        logPipeline.submit(LogRecord{ LogOp::AddProduct, id, stock, price, TimestampClock::now() });
+        return product;
+    }
+
+    // Reserve space; caller holds the catalog exclusively
+    void reserveProductsLocked(size_t count) {
+        index.reserve(count);
+        productsById.reserve(count);
+        store.reserve(count);
+    }
+
+    // Sell by id; caller holds the catalog shared
+    bool sellProductLocked(uint32_t id, int quantity) {
+        if (id < productsById.size()) {
+            bool success = store.trySell(id, quantity);
+            if (success) {
+                // One clock read stamps the log record and the demand counter
+                const TimestampClock::Timestamp stamp = TimestampClock::now();
+                store.recordDemand(id, quantity, ProductStore::demandTick(stamp.monotonicNs));
+                logPipeline.submit(LogRecord{ LogOp::Sale, id, quantity, 0.0, stamp }); // Log successful sale
+            }
+            return success;
+        }
+        return false; // Return false if product is not found or insufficient stock
+    }
+
+    // Discount by id; caller holds the catalog shared
+    bool applyDiscountLocked(uint32_t id, double percentage) {
+        if (id >= productsById.size()) return false;
+        store.applyDiscount(id, percentage);
+        logTransaction(LogOp::Discount, id, percentage); // Log discount application
+        return true;
+    }
+
+    // Serialize the catalog in id order; `heldUnits` (optional) is added to each row's stock
+    string buildSnapshotLocked(uint64_t lastSequence, const vector<int32_t>* heldUnits) const {
+        const uint32_t count = static_cast<uint32_t>(store.size());
+        size_t stringBytes = 0;
+        for (uint32_t id = 0; id < count; ++id) {
+            stringBytes += index.nameOf(id).size() + store.getTextField(id).size();
+        }
+
+        const size_t recordBytes = count * sizeof(SnapshotRecord);
+        string buffer(sizeof(SnapshotHeader) + recordBytes + stringBytes, '\0');
+        char* recordOut = &buffer[sizeof(SnapshotHeader)];
+        char* stringBase = recordOut + recordBytes;
+        uint32_t stringOffset = 0;
+
+        for (uint32_t id = 0; id < count; ++id) {
+            string_view name = index.nameOf(id);
+            SnapshotRecord record = {};
+            record.price = store.getPrice(id);
+            record.stock = store.getStock(id) + (heldUnits ? (*heldUnits)[id] : 0);
+            record.nameOffset = stringOffset;
+            record.nameLength = static_cast<uint16_t>(name.size()); // addProductLocked enforces maxStoredStringLength
+            memcpy(stringBase + stringOffset, name.data(), record.nameLength);
+            stringOffset += record.nameLength;
+
+            // The field slots are the same for every type; unused ones are 0 and empty
+            string_view text = store.getTextField(id);
+            record.type = static_cast<uint8_t>(store.getTypeTag(id));
+            record.integerField = store.getIntegerField(id);
+            if (!text.empty()) {
+                record.detailOffset = stringOffset;
+                record.detailLength = static_cast<uint16_t>(text.size());
+                memcpy(stringBase + stringOffset, text.data(), record.detailLength);
+                stringOffset += record.detailLength;
+            }
+            memcpy(recordOut, &record, sizeof(record));
+            recordOut += sizeof(record);
+        }
+
+        SnapshotHeader header = {};
+        memcpy(header.magic, snapshotMagic, sizeof(header.magic));
+        header.version = snapshotVersion;
+        header.headerSize = sizeof(SnapshotHeader);
+        header.recordCount = count;
+        header.stringTableSize = stringOffset;
+        header.lastSequence = lastSequence;
+        buffer.resize(sizeof(SnapshotHeader) + recordBytes + stringOffset);
+        header.checksum = fnv1a32(buffer.data() + sizeof(SnapshotHeader), buffer.size() - sizeof(SnapshotHeader));
+        memcpy(&buffer[0], &header, sizeof(header));
+        return buffer;
+    }
+
+    // Verify and load a snapshot image (version 1 or 2); caller holds the catalog exclusively
+    size_t loadSnapshotLocked(const string& contents, const string& fileName, uint64_t& lastSequence) {
+        SnapshotHeader header = {};
+        if (contents.size() < snapshotHeaderSizeV1) {
+            cout << "Snapshot " << fileName << " is truncated.\n";
+            return 0;
+        }
+        memcpy(&header, contents.data(), snapshotHeaderSizeV1);
+        bool knownLayout = (header.version == 1 && header.headerSize == snapshotHeaderSizeV1)
+            || (header.version == snapshotVersion && header.headerSize == sizeof(SnapshotHeader));
+        if (memcmp(header.magic, snapshotMagic, sizeof(header.magic)) != 0 || !knownLayout || contents.size() < header.headerSize) {
+            cout << "Snapshot " << fileName << " has an unsupported format.\n";
+            return 0;
+        }
+        memcpy(&header, contents.data(), header.headerSize);
+
+        const size_t recordBytes = static_cast<size_t>(header.recordCount) * sizeof(SnapshotRecord);
+        if (contents.size() != header.headerSize + recordBytes + header.stringTableSize
+            || fnv1a32(contents.data() + header.headerSize, contents.size() - header.headerSize) != header.checksum) {
+            cout << "Snapshot " << fileName << " is corrupt.\n";
+            return 0;
+        }
+        lastSequence = header.version >= 2 ? header.lastSequence : 0;
+
+        const char* recordIn = contents.data() + header.headerSize;
+        string_view strings(recordIn + recordBytes, header.stringTableSize);
+        reserveProductsLocked(productsById.size() + header.recordCount);
+        size_t loaded = 0;
+        for (uint32_t i = 0; i < header.recordCount; ++i, recordIn += sizeof(SnapshotRecord)) {
+            SnapshotRecord record;
+            memcpy(&record, recordIn, sizeof(record));
+            if (static_cast<size_t>(record.nameOffset) + record.nameLength > strings.size()
+                || static_cast<size_t>(record.detailOffset) + record.detailLength > strings.size()) {
+                continue;
+            }
+            if (!ProductTypes::isKnown(record.type)) continue;
+            addProductLocked(static_cast<ProductTypeTag>(record.type), strings.substr(record.nameOffset, record.nameLength),
+                record.price, record.stock, record.integerField, strings.substr(record.detailOffset, record.detailLength));
+            ++loaded;
+        }
+        return loaded;
+    }
+
+    // Format one product as an inventory.txt record
+    void appendInventoryRecordLocked(string& buffer, uint32_t id) const {
+        char number[32];
+        buffer += index.nameOf(id);
+        buffer += " | ";
+        buffer += productTypeName(store.getTypeTag(id));
+        buffer += " | ";
+        buffer.append(number, to_chars(number, number + sizeof(number), store.getStock(id)).ptr);
+        buffer += " | ";
+        buffer.append(number, to_chars(number, number + sizeof(number), store.getPrice(id)).ptr);
+        buffer += " | ";
+        appendProductFields(buffer, store.getTypeTag(id), store.getIntegerField(id), store.getTextField(id), FieldStyle::Record);
+        buffer += '\n';
+    }
+
+    // Format the records of `ids` in order as consecutive text shards, one
+    // slice of ids per shard on the worker pool. Each shard buffer is sized up
+    // front from the longest record its slice can produce, so formatting never
+    // reallocates. Caller holds the catalog at least shared.
+    vector<string> formatInventoryLocked(const vector<uint32_t>& ids) const {
+        const size_t fixedWidth = 64 + ProductTypes::maxFields * 16; // Longest type, the stock, a double, the integer field and the separators
+        const size_t parts = ids.size() >= 65536 ? parallelWorkerCount() * 4 : 1;
+        vector<string> shards(parts);
+        parallelFor(parts, [&](size_t part) {
+            const size_t first = ids.size() * part / parts;
+            const size_t last = ids.size() * (part + 1) / parts;
+            size_t bound = 0;
+            for (size_t i = first; i < last; ++i) {
+                bound += fixedWidth + index.nameOf(ids[i]).size() + store.getTextField(ids[i]).size();
+            }
+            shards[part].reserve(bound);
+            for (size_t i = first; i < last; ++i) appendInventoryRecordLocked(shards[part], ids[i]);
+        });
+        return shards;
+    }
+
+    // Add parsed inventory records (see parseInventoryRecords) and return how
+    // many products were added. With `upsert` (delta segments), a record for a
+    // known name overwrites its stock and price. The index slot of each record
+    // is prefetched a few records ahead, which hides most of the cache misses of
+    // a large load. Caller holds the catalog exclusively.
+    size_t loadRecordsLocked(const vector<vector<ParsedRecord>>& chunks, bool upsert) {
+        const size_t lookahead = 8;
+        size_t loaded = 0;
+        for (const vector<ParsedRecord>& records : chunks) {
+            for (size_t i = 0; i < records.size(); ++i) {
+                if (i + lookahead < records.size()) index.prefetch(records[i + lookahead].nameHash);
+                const ParsedRecord& record = records[i];
+                if (upsert) {
+                    uint32_t id = index.find(record.name);
+                    if (id != ProductIndex::npos) {
+                        if (store.getTypeTag(id) == record.type) store.setStockAndPrice(id, record.stock, record.price);
+                        continue;
+                    }
+                }
+                addProductLocked(record.type, record.name, record.nameHash, record.price, record.stock, record.integerField, record.textField);
+                ++loaded;
+            }
+        }
+        return loaded;
+    }
+
+    // Fold segments up to `through` into a new base as a background task;
+    // skipped while a previous compaction is still pending. Caller holds saveMutex.
+    void startCompactionLocked(const string& fileName, uint64_t through) {
+        if (!compactionJob.done()) return;
+        segmentsSinceCompaction = 0;
+        compactionJob = scheduler.submit(TaskPriority::Normal, [fileName, through] {
+            compactInventoryDeltas(fileName, through);
+        });
+    }
+
+    // Restock every product below the threshold, scanning slices of the stock
+    // column as parallel range tasks, and log each restock. Appends a line per
+    // product to `report` when given; returns the number restocked.
+    size_t restockBelowThreshold(int threshold, string* report) {
+        const size_t sliceRows = 1 << 16; // A multiple of 64, so slices never share a dirty word
+        OperationTimer timer(MetricOp::Restock);
+        ShardedLock::ExclusiveGuard guard(catalogLock);
+        vector<vector<uint32_t>> restocked((store.size() + sliceRows - 1) / sliceRows);
+        scheduler.forEachRange(store.size(), sliceRows, TaskPriority::Low, [&](size_t first, size_t last) {
+            restocked[first / sliceRows] = store.restockBelow(threshold, restockAmount, first, last);
+        });
+        size_t count = 0;
+        for (const vector<uint32_t>& ids : restocked) {
+            for (uint32_t id : ids) {
+                logTransaction(LogOp::Restock, id, restockAmount);
+                if (report) {
+                    *report += "Restocked ";
+                    *report += index.nameOf(id);
+                    *report += " by " + to_string(restockAmount) + " units.\n";
+                }
+            }
+            count += ids.size();
+        }
+        return count;
+    }
+
+    // Snapshot of the catalog at the WAL position it covers, returned in
+    // `through`; caller holds the catalog exclusively
+    string buildCheckpointImageLocked(uint64_t& through) const {
+        // Every change applied so far has been submitted, so this is the WAL position of the snapshot
+        through = walBaseSequence + (logPipeline.getSubmittedCount() - walBaseSubmitted) - 1;
+        // Units held by open reservations are still in stock as far as the log is concerned
+        vector<int32_t> held(store.size(), 0);
+        reservations.forEachHeld([&](const ReservationTable::Entry& entry) {
+            if (entry.productId < held.size()) held[entry.productId] += entry.quantity;
+        });
+        return buildSnapshotLocked(through, &held);
+    }
+
+    // Remove every product. Only for replicas, which take no writes: reservations
+    // and the durable log are not touched. Caller holds the catalog exclusively.
+    void clearCatalogLocked() {
+        logPipeline.drain(); // Queued text log records still name the old products
+        logPipeline.clearProducts();
+        productsById.clear();
+        nameSearch.clear();
+        expiryIndex.clear();
+        store.clear();
+        index.clear();
+        arena.clear();
+        deltaBasePath.clear(); // The next text save must be a full one
+    }
+
+    // Re-apply one logged change during recovery (no new log records are written)
+    void replayWalEntryLocked(const WalEntry& entry) {
+        const WalPayload& payload = entry.payload;
+        LogOp op = static_cast<LogOp>(payload.op);
+        if (op == LogOp::AddProduct) {
+            if (payload.productId != productsById.size()) return; // Out of step with the checkpoint
+            if (!ProductTypes::isKnown(payload.type)) return;     // Written by a build with more types
+            addProductLocked(static_cast<ProductTypeTag>(payload.type), entry.name, payload.value, payload.quantity, payload.integerField, entry.detail);
+            return;
+        }
+        if (op == LogOp::BulkDiscount) {
+            // Type-filtered discounts replay as one pass; other filters were logged per item
+            if (ProductTypes::isKnown(payload.productId)) {
+                store.discountByType(static_cast<ProductTypeTag>(payload.productId), payload.value);
+            }
+            return;
+        }
+        if (payload.productId >= store.size()) return;
+        if (op == LogOp::Sale || op == LogOp::Expire) store.addStock(payload.productId, -payload.quantity); // Commutative, replay unconditionally
+        else if (op == LogOp::Restock) store.addStock(payload.productId, payload.quantity);
+        else if (op == LogOp::Discount || op == LogOp::ItemDiscount) store.applyDiscount(payload.productId, payload.value);
+    }
+
+public:
+    // Create an empty inventory that logs transactions to the given file
+    explicit InventoryManager(const string& logFileName = "transaction_log.txt") : logPipeline(logFileName) {}
+
+    InventoryManager(const InventoryManager&) = delete;
+    InventoryManager& operator=(const InventoryManager&) = delete;
+
+    // Let a pending compaction finish, then stop the background jobs; the log
+    // pipeline drains on destruction
+    ~InventoryManager() {
+        compactionJob.wait();
+        scheduler.shutdown();
+    }
+
+    // Add a copy of a product to the inventory (if it doesn't already exist).
+    // Returns the inventory's own handle to it, valid for the manager's lifetime,
+    // or nullptr if the name is already taken.
+    Product* addProduct(const Product& product) {
+        return visitProduct(product, [&](const auto& concrete) {
+            return addProduct(concrete.tag, concrete.getProductName(), concrete.getPrice(), concrete.getStockQuantity(),
+                concrete.getIntegerField(), concrete.getTextField());
+        });
+    }
+
+    // Add a product straight from its fields, without building a temporary Product.
+    // `integer` and `text` fill the type's Integer and Text or Date fields (the
+    // warranty of Electronics, the expiration date of Food); see ProductTypes.
+    Product* addProduct(ProductTypeTag type, string_view name, double price, int stock, int integer, string_view text) {
+        ShardedLock::ExclusiveGuard guard(catalogLock);
+        return addProductLocked(type, name, price, stock, integer, text);
+    }
+
+    // Reserve index and storage space ahead of a large bulk load
+    void reserveProducts(size_t count) {
+        ShardedLock::ExclusiveGuard guard(catalogLock);
+        reserveProductsLocked(count);
+    }
+
+    // Look up the dense id for a product name (ProductIndex::npos if not found)
+    uint32_t findProductId(string_view productName) const {
+        ShardedLock::SharedGuard guard(catalogLock);
+        return index.find(productName);
+    }
+
+    // Products whose names start with `prefix`, ignoring case, in name order
+    vector<uint32_t> findProductsByPrefix(string_view prefix, size_t limit = 10) const {
+        ShardedLock::SharedGuard guard(catalogLock);
+        return nameSearch.findPrefix(prefix, limit);
+    }
+
+    // Products whose names are a close misspelling of `query`, closest first
+    vector<uint32_t> findSimilarProducts(string_view query, size_t limit = 10) const {
+        ShardedLock::SharedGuard guard(catalogLock);
+        return nameSearch.findSimilar(query, limit);
+    }
+
+    // Candidate ids for a name the operator typed: the exact match if there is
+    // one, otherwise prefix matches, otherwise close misspellings
+    vector<uint32_t> resolveProductName(string_view query, size_t limit = 10) const {
+        ShardedLock::SharedGuard guard(catalogLock);
+        uint32_t exact = index.find(query);
+        if (exact != ProductIndex::npos) return { exact };
+        vector<uint32_t> ids = nameSearch.findPrefix(query, limit);
+        if (ids.empty()) ids = nameSearch.findSimilar(query, limit);
+        return ids;
+    }
+
+    // Name of a product by id (empty if the id is unknown); valid for the manager's lifetime
+    string_view getProductName(uint32_t id) const {
+        ShardedLock::SharedGuard guard(catalogLock);
+        return id < store.size() ? index.nameOf(id) : string_view();
+    }
+
+    size_t getProductCount() const {
+        ShardedLock::SharedGuard guard(catalogLock);
+        return productsById.size();
+    }
+
+    // Current stock of a product by id (0 if the id is unknown)
+    int getStockQuantity(uint32_t id) const {
+        ShardedLock::SharedGuard guard(catalogLock);
+        return id < store.size() ? store.getStock(id) : 0;
+    }
+
+    // Total value of stock on hand (price * quantity), from the running totals
+    double getTotalStockValue() const {
+        return store.summary().total().value;
+    }
+
+    // Per-type totals and the stock-level histogram; cost does not depend on catalog size
+    StockAggregates::Summary getInventorySummary() const {
+        return store.summary();
+    }
+
+    // Number of products with stock below `threshold` (see StockAggregates::Summary::countBelow)
+    int64_t countProductsBelow(int threshold) const {
+        return store.summary().countBelow(threshold);
+    }
+
+    // Recent sales rate of a product in units per day (see ProductStore::demandPerDay)
+    double getDemandRate(uint32_t id) const {
+        ShardedLock::SharedGuard guard(catalogLock);
+        return id < store.size() ? store.demandPerDay(id, ProductStore::demandTick(TimestampClock::monotonicNs())) : 0.0;
+    }
+
+    struct HotProduct {
+        uint32_t id;
+        double unitsPerDay;
+    };
+
+    // The `k` products with the highest recent sales rate, fastest first;
+    // products with no recent sales are left out. Slices of the demand column
+    // are scanned as parallel range tasks, each keeping its own top k, and the
+    // slice results are merged, so the scan is O(n log k).
+    vector<HotProduct> getHotProducts(size_t k) {
+        typedef pair<float, uint32_t> Entry; // Decayed count, id
+        const size_t sliceRows = 1 << 16;
+        const uint32_t tick = ProductStore::demandTick(TimestampClock::monotonicNs());
+        vector<Entry> merged;
+        if (k == 0) return vector<HotProduct>();
+        {
+            ShardedLock::SharedGuard guard(catalogLock);
+            vector<vector<Entry>> slices((store.size() + sliceRows - 1) / sliceRows);
+            scheduler.forEachRange(store.size(), sliceRows, TaskPriority::Low, [&](size_t first, size_t last) {
+                vector<Entry>& top = slices[first / sliceRows]; // Min-heap of the best k so far
+                for (size_t id = first; id < last; ++id) {
+                    float count = store.getDemand(static_cast<uint32_t>(id), tick);
+                    if (count <= 0.0f || (top.size() == k && count <= top.front().first)) continue;
+                    if (top.size() == k) {
+                        pop_heap(top.begin(), top.end(), greater<Entry>());
+                        top.pop_back();
+                    }
+                    top.emplace_back(count, static_cast<uint32_t>(id));
+                    push_heap(top.begin(), top.end(), greater<Entry>());
+                }
+            });
+            for (const vector<Entry>& top : slices) merged.insert(merged.end(), top.begin(), top.end());
+        }
+        const size_t count = min(k, merged.size());
+        partial_sort(merged.begin(), merged.begin() + count, merged.end(), greater<Entry>());
+        vector<HotProduct> hot;
+        hot.reserve(count);
+        for (size_t i = 0; i < count; ++i) hot.push_back(HotProduct{ merged[i].second, ProductStore::demandRatePerDay(merged[i].first) });
+        return hot;
+    }
+
+    // Ids of the products matching the filters of `options`, in name order.
+    // offset and limit are ignored so a pager can sort and filter once and
+    // show every page from the same selection.
+    vector<uint32_t> selectInventory(const DisplayOptions& options) const {
+        ShardedLock::SharedGuard guard(catalogLock);
+        vector<uint32_t> ids = index.sortedIds();
+        auto first = ids.begin();
+        auto last = ids.end();
+        if (!options.prefix.empty()) {
+            string_view prefix = options.prefix;
+            first = lower_bound(ids.begin(), ids.end(), prefix, [this](uint32_t id, string_view key) { return index.nameOf(id) < key; });
+            last = find_if(first, ids.end(), [&](uint32_t id) { return index.nameOf(id).substr(0, prefix.size()) != prefix; });
+        }
+        last = remove_if(first, last, [&](uint32_t id) {
+            return (options.filterByType && store.getTypeTag(id) != options.type) || store.getStock(id) >= options.stockBelow;
+        });
+        return vector<uint32_t>(first, last);
+    }
+
+    // Display at most `limit` products of `ids` starting at `offset`. Lines are
+    // formatted from the columns into a buffer and written in large chunks
+    // rather than flushed line by line.
+    void displayProducts(const vector<uint32_t>& ids, size_t offset, size_t limit, ostream& out = cout) const {
+        const size_t chunkSize = 64 * 1024;
+        ShardedLock::SharedGuard guard(catalogLock);
+        if (index.empty()) {
+            out << "Inventory is empty.\n";
+            return;
+        }
+
+        string buffer;
+        buffer.reserve(chunkSize + 256);
+        char number[32];
+        size_t end = offset + min(limit, ids.size() - min(offset, ids.size()));
+        for (size_t position = offset; position < end; ++position) {
+            uint32_t id = ids[position];
+            if (id >= index.size()) continue; // The catalog was replaced since the selection
+            ProductTypeTag type = store.getTypeTag(id);
+            buffer += "Product Name: ";
+            buffer += index.nameOf(id);
+            buffer += ", Price: $";
+            buffer.append(number, to_chars(number, number + sizeof(number), store.getPrice(id), chars_format::general, 6).ptr);
+            buffer += ", Stock Quantity: ";
+            buffer.append(number, to_chars(number, number + sizeof(number), store.getStock(id)).ptr);
+            buffer += '\n';
+            appendProductFields(buffer, type, store.getIntegerField(id), store.getTextField(id), FieldStyle::Display);
+            if (buffer.size() >= chunkSize) {
+                out.write(buffer.data(), static_cast<streamsize>(buffer.size()));
+                buffer.clear();
+            }
+        }
+        out.write(buffer.data(), static_cast<streamsize>(buffer.size()));
+        out.flush();
+    }
+
+    // Display one page of the products matching `options` in name order.
+    // Returns how many products match the filters across all pages.
+    size_t displayInventory(const DisplayOptions& options = DisplayOptions(), ostream& out = cout) const {
+        vector<uint32_t> ids = selectInventory(options);
+        displayProducts(ids, options.offset, options.limit, out);
+        return ids.size();
+    }
+
+    // Sell a product by name and log the transaction
+    bool sellProduct(string_view productName, int quantity) {
+        OperationTimer timer(MetricOp::Sell, OperationTimer::hotSamplePeriod);
+        ShardedLock::SharedGuard guard(catalogLock);
+        return timer.track(sellProductLocked(index.find(productName), quantity));
+    }
+
+    // Sell a product by id and log the transaction (safe to call from many threads)
+    bool sellProductById(uint32_t id, int quantity) {
+        OperationTimer timer(MetricOp::Sell, OperationTimer::hotSamplePeriod);
+        ShardedLock::SharedGuard guard(catalogLock);
+        return timer.track(sellProductLocked(id, quantity));
+    }
+
+    // Apply a discount to a product by name and log the transaction
+    void applyDiscount(const string& productName, double percentage) {
+        bool found;
+        {
+            OperationTimer timer(MetricOp::Discount, OperationTimer::hotSamplePeriod);
+            ShardedLock::SharedGuard guard(catalogLock);
+            found = timer.track(applyDiscountLocked(index.find(productName), percentage));
+        }
+        if (!found) {
+            cout << "Product not found.\n";
+        }
+    }
+
+    // Apply a discount to a product by id and log the transaction; false if the id is unknown
+    bool applyDiscountById(uint32_t id, double percentage) {
+        OperationTimer timer(MetricOp::Discount, OperationTimer::hotSamplePeriod);
+        ShardedLock::SharedGuard guard(catalogLock);
+        return timer.track(applyDiscountLocked(id, percentage));
+    }
+
+    // Hold units of a product for a checkout without selling them yet. The units
+    // leave available stock immediately (CAS, never oversells) and come back if
+    // the reservation is released or not committed before the timeout.
+    ReservationTable::Handle reserveStock(uint32_t id, int quantity, chrono::milliseconds timeout = chrono::seconds(30)) {
+        ShardedLock::SharedGuard guard(catalogLock);
+        if (id >= store.size() || quantity <= 0 || !store.trySell(id, quantity)) return ReservationTable::Handle();
+        int64_t deadline = TimestampClock::monotonicNs() + chrono::duration_cast<chrono::nanoseconds>(timeout).count();
+        ReservationTable::Handle handle = reservations.insert(id, quantity, deadline);
+        if (!handle.valid()) store.addStock(id, quantity); // Table full: give the units back
+        return handle;
+    }
+
+    // Complete a reservation as a sale; false if it already expired or was finished
+    bool commitReservation(ReservationTable::Handle handle) {
+        ShardedLock::SharedGuard guard(catalogLock); // Keeps the commit and its log record on one side of a checkpoint
+        ReservationTable::Entry entry;
+        if (!reservations.take(handle, entry)) return false;
+        const TimestampClock::Timestamp stamp = TimestampClock::now();
+        store.recordDemand(entry.productId, static_cast<int32_t>(entry.quantity), ProductStore::demandTick(stamp.monotonicNs));
+        logPipeline.submit(LogRecord{ LogOp::Sale, entry.productId, static_cast<int32_t>(entry.quantity), 0.0, stamp });
+        return true;
+    }
+
+    // Cancel a reservation and return its units to stock; false if it was already finished
+    bool releaseReservation(ReservationTable::Handle handle) {
+        ShardedLock::SharedGuard guard(catalogLock);
+        ReservationTable::Entry entry;
+        if (!reservations.take(handle, entry)) return false;
+        store.addStock(entry.productId, entry.quantity);
+        return true;
+    }
+
+    // Return the units of every expired reservation to stock; cheap when none are outstanding
+    size_t reclaimExpiredReservations() {
+        ShardedLock::SharedGuard guard(catalogLock);
+        return reservations.reclaimExpired(TimestampClock::monotonicNs(), [this](const ReservationTable::Entry& entry) {
+            store.addStock(entry.productId, entry.quantity);
+        });
+    }
+
+    size_t getOutstandingReservations() const { return reservations.outstandingCount(); }
+
+    // Apply a basket or supplier file of operations all-or-nothing.
+    // Operations are grouped by product id; within a product, restocks count
+    // before sales, so each product needs only one stock update and one log
+    // record per kind. Groups that take stock are applied first with CAS and
+    // rolled back if any of them fails; additions and discounts cannot fail and
+    // are applied afterwards.
+    BatchResult applyBatch(const vector<InventoryOperation>& operations) {
+        BatchResult result;
+        ShardedLock::SharedGuard guard(catalogLock);
+
+        for (size_t i = 0; i < operations.size(); ++i) {
+            const InventoryOperation& op = operations[i];
+            const char* problem = op.productId >= store.size() ? "unknown product"
+                : op.kind != InventoryOperation::Kind::Discount && op.quantity <= 0 ? "quantity must be positive"
+                : op.kind == InventoryOperation::Kind::Discount && (op.percentage < 0 || op.percentage > 100) ? "discount out of range"
+                : nullptr;
+            if (problem) {
+                result.failedIndex = i;
+                result.error = problem;
+                return result;
+            }
+        }
+
+        // Group by product for locality: one entry per distinct id
+        struct Group {
+            uint32_t productId;
+            int64_t sold = 0, restocked = 0;
+            double priceFactor = 1.0;
+            bool discounted = false;
+            size_t firstIndex = 0;
+        };
+        vector<uint32_t> order(operations.size());
+        for (uint32_t i = 0; i < order.size(); ++i) order[i] = i;
+        stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+            return operations[a].productId < operations[b].productId;
+        });
+        vector<Group> groups;
+        for (uint32_t i : order) {
+            const InventoryOperation& op = operations[i];
+            if (groups.empty() || groups.back().productId != op.productId) {
+                groups.emplace_back();
+                groups.back().productId = op.productId;
+                groups.back().firstIndex = i;
+            }
+            Group& group = groups.back();
+            if (op.kind == InventoryOperation::Kind::Sell) group.sold += op.quantity;
+            else if (op.kind == InventoryOperation::Kind::Restock) group.restocked += op.quantity;
+            else {
+                group.priceFactor *= 1.0 - op.percentage / 100;
+                group.discounted = true;
+            }
+        }
+
+        // Phase 1: take stock for every net sale, rolling back on the first failure
+        for (size_t g = 0; g < groups.size(); ++g) {
+            int64_t needed = groups[g].sold - groups[g].restocked;
+            if (needed <= 0) continue;
+            if (needed > INT32_MAX || !store.trySell(groups[g].productId, static_cast<int32_t>(needed))) {
+                for (size_t undo = 0; undo < g; ++undo) {
+                    int64_t taken = groups[undo].sold - groups[undo].restocked;
+                    if (taken > 0) store.addStock(groups[undo].productId, static_cast<int32_t>(taken));
+                }
+                result.failedIndex = groups[g].firstIndex;
+                result.error = "insufficient stock";
+                return result;
+            }
+        }
+
+        // Phase 2: additions and discounts, then one grouped log submission
+        vector<LogRecord> records;
+        records.reserve(groups.size() * 2);
+        const TimestampClock::Timestamp stamp = TimestampClock::now();
+        for (const Group& group : groups) {
+            int64_t net = group.restocked - group.sold;
+            if (net > 0) store.addStock(group.productId, static_cast<int32_t>(net));
+            if (group.discounted) store.applyDiscount(group.productId, (1.0 - group.priceFactor) * 100);
+
+            if (group.sold > 0) {
+                store.recordDemand(group.productId, static_cast<int32_t>(group.sold), ProductStore::demandTick(stamp.monotonicNs));
+                records.push_back(LogRecord{ LogOp::Sale, group.productId, static_cast<int32_t>(group.sold), 0.0, stamp });
+            }
+            if (group.restocked > 0) records.push_back(LogRecord{ LogOp::Restock, group.productId, static_cast<int32_t>(group.restocked), 0.0, stamp });
+            if (group.discounted) records.push_back(LogRecord{ LogOp::Discount, group.productId, 0, (1.0 - group.priceFactor) * 100, stamp });
+        }
+        logPipeline.submitBatch(records.data(), records.size());
+        result.applied = true;
+        return result;
+    }
+
+    // Discount every product of one type in a single pass and log one aggregated record
+    size_t applyBulkDiscount(ProductTypeTag type, double percentage) {
+        OperationTimer timer(MetricOp::Discount);
+        ShardedLock::ExclusiveGuard guard(catalogLock);
+        size_t hits = store.discountByType(type, percentage);
+        logBulkDiscount(static_cast<uint32_t>(type), hits, percentage);
+        return hits;
+    }
+
+    // Discount every dated item (Food, Pharmacy) expiring within [fromDate, toDate] ("YYYY-MM-DD") via the expiry index
+    size_t applyBulkDiscountExpiring(const string& fromDate, const string& toDate, double percentage) {
+        OperationTimer timer(MetricOp::Discount);
+        ShardedLock::ExclusiveGuard guard(catalogLock);
+        vector<uint32_t> hitIds;
+        size_t hits = 0;
+        // A malformed fromDate parses to invalidDate and leaves the range open-ended
+        expiryIndex.forEachBetween(parseDateDays(fromDate), parseDateDays(toDate), [&](uint32_t id, int32_t) {
+            store.applyDiscount(id, percentage);
+            if (durableLogEnabled()) hitIds.push_back(id);
+            ++hits;
+        });
+        logBulkDiscount(0, hits, percentage);
+        logItemDiscountsForReplay(hitIds, percentage);
+        return hits;
+    }
+
+    // Discount every product the predicate accepts; it is called as matches(store, id)
+    template <typename Predicate>
+    size_t applyBulkDiscountWhere(Predicate matches, double percentage) {
+        OperationTimer timer(MetricOp::Discount);
+        ShardedLock::ExclusiveGuard guard(catalogLock);
+        const ProductStore& columns = store;
+        vector<uint32_t> hitIds;
+        size_t hits = store.discountWhere([&](uint32_t id) { return matches(columns, id); }, percentage,
+            durableLogEnabled() ? &hitIds : nullptr);
+        logBulkDiscount(0, hits, percentage);
+        logItemDiscountsForReplay(hitIds, percentage);
+        return hits;
+    }
+
+    // In-stock dated items expiring within the next `days` days (today included), earliest first
+    vector<uint32_t> findExpiringWithin(int days, int32_t today = todayDays()) const {
+        ShardedLock::SharedGuard guard(catalogLock);
+        vector<uint32_t> ids;
+        expiryIndex.forEachBetween(today, today + max(days, 0), [&](uint32_t id, int32_t) {
+            if (store.getStock(id) > 0) ids.push_back(id);
+        });
+        return ids;
+    }
+
+    // Write off the stock of every dated item that expired before today.
+    // Expired items stay in the expiry index, since a restock of an expired
+    // item must be written off by the next sweep too; they hold no stock
+    // between sweeps, so revisiting them is cheap. Returns the number of units removed.
+    size_t removeExpiredStock(int32_t today = todayDays()) {
+        ShardedLock::ExclusiveGuard guard(catalogLock);
+        vector<LogRecord> records;
+        const TimestampClock::Timestamp stamp = TimestampClock::now();
+        size_t units = 0;
+        expiryIndex.forEachBetween(INT32_MIN, today - 1, [&](uint32_t id, int32_t) {
+            int32_t removed = store.takeAllStock(id);
+            if (removed <= 0) return;
+            units += removed;
+            records.push_back(LogRecord{ LogOp::Expire, id, removed, 0.0, stamp });
+        });
+        logPipeline.submitBatch(records.data(), records.size());
+        return units;
+    }
+
+    // Save the inventory to a text file. The first save to a file, or one made
+    // after most products changed, rewrites it in full; later saves append only
+    // the products changed since the previous save, as a new delta segment.
+    // Every file goes through a temp file and an atomic rename, and once enough
+    // segments pile up a background compaction folds them into a fresh base.
+    void saveInventoryToFile(const string& fileName = "inventory.txt") {
+        OperationTimer timer(MetricOp::Save);
+        lock_guard<mutex> saveLock(saveMutex);
+        const vector<uint64_t> segmentsOnDisk = listDeltaSegments(fileName);
+        const uint64_t through = max(nextSegment - 1, segmentsOnDisk.empty() ? uint64_t(0) : segmentsOnDisk.back());
+        bool delta = fileName == deltaBasePath && filesystem::exists(fileName);
+        vector<uint32_t> changed;
+        string buffer;
+        vector<string> shards; // Full saves: consecutive slices of the file
+        {
+            ShardedLock::SharedGuard guard(catalogLock);
+            changed = store.takeDirty();
+            delta = delta && changed.size() <= store.size() / 2;
+            if (delta) {
+                buffer.reserve(changed.size() * 64);
+                for (uint32_t id : changed) appendInventoryRecordLocked(buffer, id);
+            }
+            else {
+                buffer += deltaBaseHeader;
+                buffer += to_string(through);
+                buffer += '\n';
+                shards = formatInventoryLocked(index.sortedIds());
+            }
+        }
+
+        if (delta) {
+            if (changed.empty()) return; // Nothing changed since the last save
+            string segmentPath = deltaSegmentPath(fileName, nextSegment);
+            if (!writeFileAtomically(segmentPath, buffer)) {
+                store.markDirty(changed); // Keep them for the next save
+                timer.track(false);
+                cout << "Could not write " << segmentPath << ".\n";
+                return;
+            }
+            inventoryMetrics.addBytes(MetricSink::InventoryFile, buffer.size());
+            ++nextSegment;
+            if (++segmentsSinceCompaction >= compactAfterSegments) startCompactionLocked(fileName, nextSegment - 1);
+            return;
+        }
+
+        // A compaction still running would rename its older base over this one
+        compactionJob.wait();
+        vector<string_view> pieces{ buffer };
+        size_t bytes = buffer.size();
+        for (const string& shard : shards) {
+            pieces.push_back(shard);
+            bytes += shard.size();
+        }
+        if (!writeFileAtomically(fileName, pieces)) {
+            store.markDirty(changed);
+            timer.track(false);
+            cout << "Could not write " << fileName << ".\n";
+            return;
+        }
+        inventoryMetrics.addBytes(MetricSink::InventoryFile, bytes);
+        error_code ec;
+        for (uint64_t number : segmentsOnDisk) {
+            if (number <= through) filesystem::remove(deltaSegmentPath(fileName, number), ec);
+        }
+        deltaBasePath = fileName;
+        nextSegment = through + 1;
+        segmentsSinceCompaction = 0;
+    }
+
+    // Rebuild products from a saved inventory file and its delta segments and
+    // return how many products were loaded. Each file is read in one chunk and
+    // tokenized in place on the worker pool before the catalog is locked; only
+    // the merge into the index runs under the lock, serially and in file order.
+    size_t loadInventoryFromFile(const string& fileName = "inventory.txt") {
+        OperationTimer timer(MetricOp::Load);
+        string contents;
+        if (!timer.track(readWholeFile(fileName, contents))) return 0;
+        uint64_t lastSegment = deltaBaseThrough(contents);
+        vector<string> segments;
+        for (uint64_t number : listDeltaSegments(fileName)) {
+            if (number <= lastSegment) continue; // Already folded into the base
+            segments.emplace_back();
+            if (readWholeFile(deltaSegmentPath(fileName, number), segments.back())) lastSegment = number;
+            else segments.pop_back();
+        }
+
+        vector<vector<ParsedRecord>> baseRecords = parseInventoryRecords(contents);
+        vector<vector<vector<ParsedRecord>>> segmentRecords;
+        for (const string& segment : segments) segmentRecords.push_back(parseInventoryRecords(segment));
+        size_t recordCount = 0;
+        for (const vector<ParsedRecord>& records : baseRecords) recordCount += records.size();
+
+        lock_guard<mutex> saveLock(saveMutex);
+        ShardedLock::ExclusiveGuard guard(catalogLock);
+        const bool fresh = productsById.empty();
+        reserveProductsLocked(productsById.size() + recordCount);
+        size_t loaded = loadRecordsLocked(baseRecords, false);
+        for (const vector<vector<ParsedRecord>>& records : segmentRecords) loaded += loadRecordsLocked(records, true);
+
+        if (fresh) {
+            // The catalog now matches the files, so the next save can be a delta
+            store.takeDirty();
+            deltaBasePath = fileName;
+            nextSegment = lastSegment + 1;
+            segmentsSinceCompaction = segments.size();
+        }
+        return loaded;
+    }
+
+    // Save the inventory as a binary snapshot built in memory and written in one call
+    bool saveInventorySnapshot(const string& fileName = "inventory.bin") const {
+        OperationTimer timer(MetricOp::Save);
+        string buffer;
+        {
+            ShardedLock::SharedGuard guard(catalogLock);
+            buffer = buildSnapshotLocked(0, nullptr);
+        }
+        bool written = writeFileAtomically(fileName, buffer);
+        inventoryMetrics.addBytes(MetricSink::Snapshot, buffer.size());
+        return timer.track(written);
+    }
+
+    // Rebuild products from a binary snapshot and return how many were loaded.
+    // The header, sizes and checksum are verified before anything is added.
+    size_t loadInventorySnapshot(const string& fileName = "inventory.bin") {
+        OperationTimer timer(MetricOp::Load);
+        string contents;
+        if (!timer.track(readWholeFile(fileName, contents))) return 0;
+        ShardedLock::ExclusiveGuard guard(catalogLock);
+        uint64_t lastSequence = 0;
+        return loadSnapshotLocked(contents, fileName, lastSequence);
+    }
+
+    // Recover from the last checkpoint plus the write-ahead log tail, then start
+    // logging every change to the WAL and checkpointing in the background.
+    // Returns the number of products recovered (0 on a fresh start). Call once,
+    // before any other thread uses the manager.
+    size_t enableDurableLog(const string& walFile = "inventory.wal", const string& checkpointFile = "inventory.checkpoint",
+        chrono::seconds interval = chrono::seconds(60)) {
+        OperationTimer timer(MetricOp::Load);
+        ShardedLock::ExclusiveGuard guard(catalogLock);
+        uint64_t lastSequence = 0;
+        string contents;
+        if (readWholeFile(checkpointFile, contents)) {
+            loadSnapshotLocked(contents, checkpointFile, lastSequence);
+        }
+
+        if (readWholeFile(walFile, contents)) {
+            size_t replayed = 0;
+            size_t intact = WriteAheadLog::scan(contents, [&](const WalEntry& entry, string_view) {
+                if (entry.sequence <= lastSequence) return; // Already in the checkpoint
+                replayWalEntryLocked(entry);
+                lastSequence = entry.sequence;
+                ++replayed;
+            });
+            if (intact < contents.size()) {
+                cout << "Discarding " << (contents.size() - intact) << " bytes of incomplete log tail.\n";
+                error_code ec;
+                if (intact < WriteAheadLog::fileHeaderSize) filesystem::remove(walFile, ec);
+                else filesystem::resize_file(walFile, intact, ec);
+            }
+            if (replayed > 0) cout << "Replayed " << replayed << " logged transactions.\n";
+        }
+
+        logPipeline.drain(); // Nothing recovered above may reach the new log
+        logPipeline.attachWriteAheadLog(make_unique<WriteAheadLog>(walFile, lastSequence + 1));
+        walBaseSequence = lastSequence + 1;
+        walBaseSubmitted = logPipeline.getSubmittedCount();
+        checkpointPath = checkpointFile;
+
+        checkpointJob = scheduler.schedulePeriodic(interval, TaskPriority::Normal, [this] {
+            checkpoint();
+            writeMetricsFile();
+        });
+        return productsById.size();
+    }
+
+    // Write a snapshot consistent with a known WAL position, then let the log
+    // writer drop the records it covers. Recovery never replays more than one
+    // checkpoint interval of history.
+    bool checkpoint() {
+        if (checkpointPath.empty()) return false;
+        OperationTimer timer(MetricOp::Checkpoint);
+        string image;
+        uint64_t through;
+        {
+            ShardedLock::ExclusiveGuard guard(catalogLock);
+            image = buildCheckpointImageLocked(through);
+            store.recountAggregates();
+        }
+
+        if (!writeFileAtomically(checkpointPath, image)) return timer.track(false);
+        inventoryMetrics.addBytes(MetricSink::Snapshot, image.size());
+        logPipeline.requestWalCompaction(through);
+        return true;
+    }
+
+    // Primary side of log shipping: a snapshot for bootstrapping a replica and
+    // the WAL position it covers. Needs enableDurableLog.
+    string buildReplicaSnapshot(uint64_t& through) {
+        ShardedLock::ExclusiveGuard guard(catalogLock);
+        return buildCheckpointImageLocked(through);
+    }
+
+    // WAL position of the last change submitted so far; every later change
+    // reaches an observer installed before the call
+    uint64_t getLoggedSequence() const {
+        ShardedLock::SharedGuard guard(catalogLock);
+        return walBaseSequence + (logPipeline.getSubmittedCount() - walBaseSubmitted) - 1;
+    }
+
+    // Primary side: hand every flushed WAL batch to `observer` on the log
+    // writer thread; false until enableDurableLog has run
+    bool setWalFlushObserver(function<void(string_view frames, uint64_t lastSequence)> observer) {
+        return logPipeline.setWalFlushObserver(move(observer));
+    }
+
+    // Replica side: replace the catalog with a primary's bootstrap snapshot
+    // and return the WAL position it covers in `through`. A replica that falls
+    // too far behind, or follows a primary that restarted, re-bootstraps this
+    // way. A damaged image is reported and leaves the catalog empty.
+    void loadReplicaSnapshot(const string& image, uint64_t& through) {
+        ShardedLock::ExclusiveGuard guard(catalogLock);
+        if (!productsById.empty()) clearCatalogLocked();
+        through = 0;
+        loadSnapshotLocked(image, "replication snapshot", through);
+    }
+
+    // Replica side: apply shipped WAL records in sequence order. Records at or
+    // below `applied` are skipped and `applied` and `lastStampNs` follow the
+    // records applied. Returns false at a gap in the sequence.
+    bool applyReplicatedRecords(string_view frames, uint64_t& applied, int64_t& lastStampNs) {
+        ShardedLock::ExclusiveGuard guard(catalogLock);
+        bool inOrder = true;
+        WriteAheadLog::scanFrames(frames, [&](const WalEntry& entry, string_view) {
+            if (!inOrder || entry.sequence <= applied) return;
+            if (entry.sequence != applied + 1) {
+                inOrder = false;
+                return;
+            }
+            replayWalEntryLocked(entry);
+            applied = entry.sequence;
+            lastStampNs = entry.payload.timestampNs;
+        });
+        return inOrder;
+    }
+
+    // Check the inventory for low stock items and restock them if necessary
+    void checkAndRestock(int threshold) {
+        string report;
+        restockBelowThreshold(threshold, &report);
+        cout << report;
+    }
+
+    // Give one product a replenishment policy; false if the id is unknown
+    bool setReplenishmentPolicy(uint32_t id, const ReplenishmentPolicy& policy) {
+        ShardedLock::ExclusiveGuard guard(catalogLock);
+        if (id >= store.size()) return false;
+        store.setPolicy(id, policy);
+        return true;
+    }
+
+    // Policy for every product that has none yet and for products added later
+    void setDefaultReplenishmentPolicy(const ReplenishmentPolicy& policy) {
+        ShardedLock::ExclusiveGuard guard(catalogLock);
+        defaultPolicy = policy;
+        for (uint32_t id = 0; id < store.size(); ++id) {
+            if (store.getPolicy(id).rule == ReorderRule::None) store.setPolicy(id, policy);
+        }
+    }
+
+    ReplenishmentPolicy getReplenishmentPolicy(uint32_t id) const {
+        ShardedLock::SharedGuard guard(catalogLock);
+        return id < store.size() ? store.getPolicy(id) : ReplenishmentPolicy();
+    }
+
+    // Products waiting for the next replenish pass
+    size_t getPendingReplenishments() { return store.triggeredCount(); }
+
+    // Order stock for the products whose stock fell below their reorder point
+    // since the last pass. Sales queue a product the moment it crosses, so a
+    // pass costs O(triggered products), not a catalog scan, and runs beside
+    // sales under the shared lock. Appends a line per order to `report` when
+    // given; returns the number of products restocked.
+    size_t replenish(string* report = nullptr) {
+        OperationTimer timer(MetricOp::Restock);
+        lock_guard<mutex> passLock(replenishMutex);
+        ShardedLock::SharedGuard guard(catalogLock);
+        const uint32_t tick = ProductStore::demandTick(TimestampClock::monotonicNs());
+        size_t restocked = 0;
+        for (uint32_t id : store.takeTriggered()) {
+            const ReplenishmentPolicy& policy = store.getPolicy(id);
+            const int32_t stock = store.getStock(id);
+            if (policy.rule == ReorderRule::None || stock >= policy.reorderPoint) continue; // Restocked some other way since
+            const int32_t quantity = policy.orderQuantity(stock, store.demandPerDay(id, tick));
+            if (quantity <= 0) continue;
+            store.addStock(id, quantity);
+            logTransaction(LogOp::Restock, id, quantity);
+            if (report) {
+                *report += "Restocked ";
+                *report += index.nameOf(id);
+                *report += " by " + to_string(quantity) + " units.\n";
+            }
+            ++restocked;
+        }
+        return restocked;
+    }
+
+    // Intervals of the recurring background jobs; a zero interval leaves that job off
+    struct MaintenanceSchedule {
+        chrono::milliseconds reservationSweep{ 1000 }; // Reclaim expired checkouts (high priority)
+        chrono::milliseconds replenishment{ 1000 };    // replenish() the products below their reorder point
+        chrono::milliseconds expirySweep{ 0 };         // Write off expired Food and Pharmacy stock
+        chrono::milliseconds restockScan{ 0 };         // Restock below restockThreshold, without the report
+        int restockThreshold = 10;
+        chrono::milliseconds autosave{ 0 };            // Save to the default file; a binary snapshot with autosaveSnapshot
+        bool autosaveSnapshot = false;
+        chrono::milliseconds metricsReport{ 0 };       // writeMetricsFile (see setMetricsFile)
+    };
+
+    // Run the recurring jobs of `schedule` on the background scheduler instead
+    // of the calling thread, replacing any started before
+    void startMaintenance(const MaintenanceSchedule& schedule) {
+        stopMaintenance();
+        auto every = [this](chrono::milliseconds period, TaskPriority priority, function<void()> job) {
+            if (period > chrono::milliseconds::zero()) maintenanceJobs.push_back(scheduler.schedulePeriodic(period, priority, move(job)));
+        };
+        every(schedule.reservationSweep, TaskPriority::High, [this] { reclaimExpiredReservations(); });
+        every(schedule.replenishment, TaskPriority::Normal, [this] { replenish(); });
+        every(schedule.expirySweep, TaskPriority::Low, [this] { removeExpiredStock(); });
+        every(schedule.restockScan, TaskPriority::Low, [this, threshold = schedule.restockThreshold] { restockBelowThreshold(threshold, nullptr); });
+        every(schedule.autosave, TaskPriority::Low, [this, snapshot = schedule.autosaveSnapshot] {
+            if (snapshot) saveInventorySnapshot();
+            else saveInventoryToFile();
+        });
+        every(schedule.metricsReport, TaskPriority::Low, [this] { writeMetricsFile(); });
+    }
+
+    // Cancel the recurring jobs and wait for any run in progress
+    void stopMaintenance() {
+        for (const TaskScheduler::Handle& job : maintenanceJobs) job.cancel();
+        for (const TaskScheduler::Handle& job : maintenanceJobs) job.wait();
+        maintenanceJobs.clear();
+    }
+
+    // Restock a product by a set amount and log the transaction
+    void restockProduct(const Product& product) {
+        restockProductById(product.getProductId());
+    }
+
+    // Restock a product by id without touching its façade object
+    void restockProductById(uint32_t id) {
+        string name;
+        {
+            OperationTimer timer(MetricOp::Restock, OperationTimer::hotSamplePeriod);
+            ShardedLock::SharedGuard guard(catalogLock);
+            if (!timer.track(id < store.size())) return;
+            store.addStock(id, restockAmount);
+            logTransaction(LogOp::Restock, id, restockAmount);
+            name = index.nameOf(id);
+        }
+        cout << "Restocked " << name << " by " << restockAmount << " units.\n";
+    }
+
+    // Log transaction involving quantity change (integer-based) with timestamp
+    void logTransaction(LogOp op, uint32_t productId, int quantity) const {
+        logPipeline.submit(LogRecord{ op, productId, quantity, 0.0, TimestampClock::now() });
+    }
+
+    // Log transaction involving discount percentage with timestamp
+    void logTransaction(LogOp op, uint32_t productId, double percentage) const {
+        logPipeline.submit(LogRecord{ op, productId, 0, percentage, TimestampClock::now() });
+    }
+
+    // Log one record summarizing a bulk discount (filter is a ProductTypeTag or 0)
+    void logBulkDiscount(uint32_t filter, size_t items, double percentage) const {
+        logPipeline.submit(LogRecord{ LogOp::BulkDiscount, filter, static_cast<int32_t>(items), percentage, TimestampClock::now() });
+    }
+
+    // A filtered bulk discount cannot be replayed from its summary record, so
+    // the write-ahead log also gets one ItemDiscount per affected product
+    void logItemDiscountsForReplay(const vector<uint32_t>& ids, double percentage) const {
+        if (ids.empty()) return;
+        vector<LogRecord> records;
+        records.reserve(ids.size());
+        const TimestampClock::Timestamp stamp = TimestampClock::now();
+        for (uint32_t id : ids) records.push_back(LogRecord{ LogOp::ItemDiscount, id, 0, percentage, stamp });
+        logPipeline.submitBatch(records.data(), records.size());
+    }
+
+    bool durableLogEnabled() const { return !checkpointPath.empty(); }
+
+    // Wait until every logged transaction has been written to disk
+    void flushLog() const {
+        logPipeline.drain();
+    }
+
+    // Operation counters and latencies plus the log queue gauges
+    InventoryMetrics::Snapshot getMetrics() const {
+        InventoryMetrics::Snapshot snapshot = inventoryMetrics.snapshot();
+        snapshot.logQueueDepth = logPipeline.getQueueDepth();
+        snapshot.logRecordsDropped = logPipeline.getDroppedCount();
+        snapshot.replicationRole = replicationGauges.role.load(memory_order_relaxed);
+        snapshot.replicationSequence = replicationGauges.sequence.load(memory_order_relaxed);
+        snapshot.replicationSubscribers = replicationGauges.subscribers.load(memory_order_relaxed);
+        snapshot.replicationLagRecords = replicationGauges.lagRecords.load(memory_order_relaxed);
+        snapshot.replicationLagMs = replicationGauges.lagMs.load(memory_order_relaxed);
+        return snapshot;
+    }
+
+    // Rewrite the metrics file after every background checkpoint (call before enableDurableLog)
+    void setMetricsFile(const string& fileName) {
+        metricsPath = fileName;
+    }
+
+    // Write the metrics in text exposition format to the metrics file via a temp
+    // file and rename, so a scraper never reads a partial dump
+    bool writeMetricsFile() const {
+        if (metricsPath.empty()) return false;
+        return writeFileAtomically(metricsPath, formatMetricsText(getMetrics()));
+    }
+};
+
+// Helper function to get and validate integer input from the user
+int getValidatedInt(const string& prompt, int minValue = INT_MIN) {
+    int value;
+    while (true) {
+        cout << prompt;
+        cin >> value;
+        if (cin.fail() || value < minValue) {
+            cin.clear();
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+            cout << "Invalid input. Please try again.\n";
+        }
+        else {
+            cin.ignore();
+            return value;
+        }
+    }
+}
+
+// Helper function to get and validate double input from the user
+double getValidatedDouble(const string& prompt, double minValue = -DBL_MAX) {
+    double value;
+    while (true) {
+        cout << prompt;
+        cin >> value;
+        if (cin.fail() || value < minValue) {
+            cin.clear();
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+            cout << "Invalid input. Please try again.\n";
+        }
+        else {
+            cin.ignore();
+            return value;
+        }
+    }
+}
+
+// Helper function to get "yes" or "no" input from user
+string getYesOrNoInput(const string& prompt) {
+    string input;
+    while (true) {
+        cout << prompt;
+        if (!getline(cin, input)) return "no"; // End of input
+        transform(input.begin(), input.end(), input.begin(), ::tolower);
+
+        if (input == "yes" || input == "no") {
+            return input;
+        }
+        else {
+            cout << "Invalid input. Please enter 'yes' or 'no'.\n";
+        }
+    }
+}
+// Helper function to validate dates (YYYY-MM-DD, including month lengths and leap years)
+bool isValidDateFormat(const string& date) {
+    return parseDateDays(date) != invalidDate;
+}
+
+// "Electronics, Food, ... or Pharmacy" for the product type prompt
+string productTypeChoices() {
+    string choices;
+    for (size_t i = 0; i < ProductTypes::count; ++i) {
+        if (i > 0) choices += i + 1 == ProductTypes::count ? " or " : ", ";
+        choices += productTypeName(ProductTypes::tags[i]);
+    }
+    return choices;
+}
+
+// Ask for the fields `Type` declares, in record order, validating numbers and dates
+template <typename Type>
+void promptTypeFields(int& integer, string& text) {
+    for (const ProductField& field : Type::fields) {
+        if (field.kind == FieldKind::Integer) {
+            integer = getValidatedInt(string(field.prompt), 0);
+            continue;
+        }
+        while (true) {
+            cout << field.prompt;
+            if (!getline(cin, text)) break; // End of input
+            if (field.kind != FieldKind::Date || isValidDateFormat(text)) break;
+            cout << "Invalid date format or value. Please try again.\n";
+        }
+    }
+}
+
+// promptTypeFields() for a type known only at run time
+void promptProductFields(ProductTypeTag type, int& integer, string& text) {
+    ProductTypes::dispatch(type, [&](auto declared) { promptTypeFields<typename decltype(declared)::type>(integer, text); });
+}
+
+/*
+ * Sockets for the network service, over Winsock on Windows and BSD sockets
+ * elsewhere. Handles are non-blocking once accepted or bound.
+ */
+#ifdef _WIN32
+typedef SOCKET SocketHandle;
+inline const SocketHandle invalidSocket = INVALID_SOCKET;
+
+inline void closeSocket(SocketHandle socket) { closesocket(socket); }
+inline void shutdownSocket(SocketHandle socket) { shutdown(socket, SD_BOTH); }
+inline bool socketWouldBlock() { return WSAGetLastError() == WSAEWOULDBLOCK; }
+
+inline bool setNonBlocking(SocketHandle socket, bool enabled = true) {
+    u_long mode = enabled ? 1 : 0;
+    return ioctlsocket(socket, FIONBIO, &mode) == 0;
+}
+
+// Winsock must be started once per process before the first socket call
+inline bool startSockets() {
+    static const bool started = [] {
+        WSADATA data;
+        return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+    }();
+    return started;
+}
+#else
+typedef int SocketHandle;
+inline const SocketHandle invalidSocket = -1;
+
+inline void closeSocket(SocketHandle socket) { close(socket); }
+inline void shutdownSocket(SocketHandle socket) { shutdown(socket, SHUT_RDWR); }
+inline bool socketWouldBlock() { return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR; }
+
+inline bool setNonBlocking(SocketHandle socket, bool enabled = true) {
+    int flags = fcntl(socket, F_GETFL, 0);
+    return flags >= 0 && fcntl(socket, F_SETFL, enabled ? flags | O_NONBLOCK : flags & ~O_NONBLOCK) == 0;
+}
+
+inline bool startSockets() {
+    signal(SIGPIPE, SIG_IGN); // A client that disconnects must not kill the server
+    return true;
+}
+#endif
+
+// Send and receive with the byte counts both platforms accept; < 0 on error
+inline long long sendSome(SocketHandle socket, const char* data, size_t size) {
+#ifdef MSG_NOSIGNAL
+    return send(socket, data, static_cast<int>(min<size_t>(size, INT_MAX)), MSG_NOSIGNAL);
+#else
+    return send(socket, data, static_cast<int>(min<size_t>(size, INT_MAX)), 0);
+#endif
+}
+
+inline long long receiveSome(SocketHandle socket, char* data, size_t size) {
+    return recv(socket, data, static_cast<int>(min<size_t>(size, INT_MAX)), 0);
+}
+
+// Blocking sockets: send or receive exactly `size` bytes; false if the connection failed
+inline bool sendAll(SocketHandle socket, const char* data, size_t size) {
+    for (size_t done = 0; done < size;) {
+        long long n = sendSome(socket, data + done, size - done);
+        if (n <= 0) return false;
+        done += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+inline bool receiveAll(SocketHandle socket, char* data, size_t size) {
+    for (size_t done = 0; done < size;) {
+        long long n = receiveSome(socket, data + done, size - done);
+        if (n <= 0) return false;
+        done += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Open a blocking TCP connection to host:port; invalidSocket on failure
+inline SocketHandle connectTo(const string& host, uint16_t port) {
+    if (!startSockets()) return invalidSocket;
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* results = nullptr;
+    if (getaddrinfo(host.c_str(), to_string(port).c_str(), &hints, &results) != 0) return invalidSocket;
+    SocketHandle connected = invalidSocket;
+    for (addrinfo* candidate = results; candidate && connected == invalidSocket; candidate = candidate->ai_next) {
+        SocketHandle attempt = socket(candidate->ai_family, candidate->ai_socktype, candidate->ai_protocol);
+        if (attempt == invalidSocket) continue;
+        if (connect(attempt, candidate->ai_addr, static_cast<socklen_t>(candidate->ai_addrlen)) == 0) connected = attempt;
+        else closeSocket(attempt);
+    }
+    freeaddrinfo(results);
+    if (connected != invalidSocket) {
+        int noDelay = 1;
+        setsockopt(connected, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+    }
+    return connected;
+}
+
+/*
+ * Readiness polling for one event loop: epoll on Linux, poll() on other
+ * POSIX systems and WSAPoll on Windows. Only the loop's own thread uses it.
+ */
+class SocketPoller {
+public:
+    struct Event {
+        SocketHandle socket;
+        bool readable;
+        bool writable;
+        bool failed; // Error or hang-up
+    };
+
+private:
+#ifdef __linux__
+    int epollHandle = epoll_create1(0);
+    vector<epoll_event> ready = vector<epoll_event>(256);
+
+    bool control(int operation, SocketHandle socket, bool wantRead, bool wantWrite) {
+        epoll_event event{};
+        event.events = (wantRead ? EPOLLIN | EPOLLRDHUP : 0u) | (wantWrite ? EPOLLOUT : 0u);
+        event.data.fd = socket;
+        return epoll_ctl(epollHandle, operation, socket, &event) == 0;
+    }
+
+public:
+    SocketPoller() = default;
+    SocketPoller(const SocketPoller&) = delete;
+    SocketPoller& operator=(const SocketPoller&) = delete;
+    ~SocketPoller() { close(epollHandle); }
+
+    bool add(SocketHandle socket) { return control(EPOLL_CTL_ADD, socket, true, false); }
+    bool update(SocketHandle socket, bool wantRead, bool wantWrite) { return control(EPOLL_CTL_MOD, socket, wantRead, wantWrite); }
+    void remove(SocketHandle socket) { epoll_ctl(epollHandle, EPOLL_CTL_DEL, socket, nullptr); }
+
+    // Wait up to `timeoutMs` and replace `events` with the sockets that are ready
+    void wait(int timeoutMs, vector<Event>& events) {
+        events.clear();
+        int count = epoll_wait(epollHandle, ready.data(), static_cast<int>(ready.size()), timeoutMs);
+        for (int i = 0; i < count; ++i) {
+            uint32_t flags = ready[i].events;
+            events.push_back(Event{ ready[i].data.fd, (flags & EPOLLIN) != 0, (flags & EPOLLOUT) != 0,
+                (flags & (EPOLLERR | EPOLLHUP)) != 0 });
+        }
+    }
+#else
+    vector<pollfd> sockets;
+
+public:
+    bool add(SocketHandle socket) {
+        pollfd entry{};
+        entry.fd = socket;
+        entry.events = POLLIN;
+        sockets.push_back(entry);
+        return true;
+    }
+
+    bool update(SocketHandle socket, bool wantRead, bool wantWrite) {
+        for (pollfd& entry : sockets) {
+            if (entry.fd == socket) entry.events = static_cast<short>((wantRead ? POLLIN : 0) | (wantWrite ? POLLOUT : 0));
+        }
+        return true;
+    }
+
+    void remove(SocketHandle socket) {
+        sockets.erase(remove_if(sockets.begin(), sockets.end(), [socket](const pollfd& entry) { return entry.fd == socket; }), sockets.end());
+    }
+
+    void wait(int timeoutMs, vector<Event>& events) {
+        events.clear();
+#ifdef _WIN32
+        int count = WSAPoll(sockets.data(), static_cast<ULONG>(sockets.size()), timeoutMs);
+#else
+        int count = poll(sockets.data(), static_cast<nfds_t>(sockets.size()), timeoutMs);
+#endif
+        for (size_t i = 0; i < sockets.size() && count > 0; ++i) {
+            short flags = sockets[i].revents;
+            if (!flags) continue;
+            --count;
+            events.push_back(Event{ sockets[i].fd, (flags & POLLIN) != 0, (flags & POLLOUT) != 0,
+                (flags & (POLLERR | POLLHUP | POLLNVAL)) != 0 });
+        }
+    }
+#endif
+};
+
+/*
+ * Binary protocol of the network service.
+ * Clients send request frames and may pipeline any number of them; a packet
+ * can carry many frames and a frame can span packets. Every request gets one
+ * 16-byte response, in request order per connection. All integers are
+ * little-endian.
+ *   Request:  u8 op | u8 reserved | u16 payloadLength | u32 tag | u32 productId | i32 argument | payload
+ *   Response: u32 tag | u8 op | u8 status | u16 reserved | i64 value
+ * The tag is echoed back untouched so clients can match responses to requests.
+ */
+enum class WireOp : uint8_t {
+    Ping = 0,     // value = 0
+    Lookup = 1,   // payload = product name; value = product id
+    Stock = 2,    // value = units in stock
+    Sell = 3,     // argument = quantity
+    Discount = 4, // argument = percentage in hundredths of a percent
+    Value = 5     // value = total stock value in cents
+};
+
+enum class WireStatus : uint8_t { Ok = 0, NotFound = 1, Rejected = 2, BadRequest = 3, ReadOnly = 4 };
+
+inline constexpr size_t wireRequestSize = 16;
+inline constexpr size_t wireResponseSize = 16;
+inline constexpr size_t wireMaxPayload = 4096;
+
+inline uint32_t loadLittle32(const char* bytes) {
+    const unsigned char* b = reinterpret_cast<const unsigned char*>(bytes);
+    return uint32_t(b[0]) | uint32_t(b[1]) << 8 | uint32_t(b[2]) << 16 | uint32_t(b[3]) << 24;
+}
+
+inline void storeLittle(char* bytes, uint64_t value, size_t width) {
+    for (size_t i = 0; i < width; ++i) bytes[i] = static_cast<char>(value >> (8 * i));
+}
+
+// Serialize a request frame (used by clients and the server benchmark)
+inline void appendWireRequest(string& out, WireOp op, uint32_t tag, uint32_t productId, int32_t argument, string_view payload = string_view()) {
+    char frame[wireRequestSize] = {};
+    frame[0] = static_cast<char>(op);
+    storeLittle(frame + 2, payload.size(), 2);
+    storeLittle(frame + 4, tag, 4);
+    storeLittle(frame + 8, productId, 4);
+    storeLittle(frame + 12, static_cast<uint32_t>(argument), 4);
+    out.append(frame, sizeof(frame));
+    out.append(payload.data(), payload.size());
+}
+
+/*
+ * TCP front end that runs InventoryManager operations for remote registers.
+ * Each worker thread runs its own event loop over its own connections; the
+ * listening socket is shared and whichever loop wakes first accepts. A loop
+ * answers every complete frame of a read in one pass, writing the responses
+ * straight into the connection's output buffer in wire format, and hands that
+ * buffer to send() as is: one send per batch of requests, no per-response copy.
+ * A connection whose client stops reading is not read from again until its
+ * buffered responses drain.
+ */
+class InventoryServer {
+    struct Connection {
+        string input;
+        size_t inputStart = 0; // Bytes of `input` already parsed
+        string output;
+        size_t outputStart = 0; // Bytes of `output` already sent
+        bool wantRead = true;   // Interest registered with the poller
+        bool wantWrite = false;
+    };
+
+    static constexpr size_t readChunk = 64 * 1024;
+    static constexpr size_t outputLimit = 4 * 1024 * 1024; // Stop reading a connection above this backlog
+
+    InventoryManager& manager;
+    const bool readOnly; // Replicas answer reads and refuse sells and discounts
+    SocketHandle listener = invalidSocket;
+    uint16_t boundPort = 0;
+    atomic<bool> stopping{ false };
+    vector<thread> loops;
+    atomic<uint64_t> served{ 0 };
+
+    // Answer one request into `out`
+    void execute(WireOp op, uint32_t tag, uint32_t productId, int32_t argument, string_view payload, string& out) {
+        WireStatus status = WireStatus::Ok;
+        int64_t value = 0;
+        switch (op) {
+        case WireOp::Ping:
+            break;
+        case WireOp::Lookup: {
+            uint32_t id = manager.findProductId(payload);
+            if (id == ProductIndex::npos) status = WireStatus::NotFound;
+            else value = id;
+            break;
+        }
+        case WireOp::Stock:
+            if (productId >= manager.getProductCount()) status = WireStatus::NotFound;
+            else value = manager.getStockQuantity(productId);
+            break;
+        case WireOp::Sell:
+            if (readOnly) status = WireStatus::ReadOnly;
+            else if (argument <= 0) status = WireStatus::BadRequest;
+            else if (!manager.sellProductById(productId, argument)) {
+                status = productId < manager.getProductCount() ? WireStatus::Rejected : WireStatus::NotFound;
+            }
+            break;
+        case WireOp::Discount:
+            if (readOnly) status = WireStatus::ReadOnly;
+            else if (argument < 0 || argument > 10000) status = WireStatus::BadRequest;
+            else if (!manager.applyDiscountById(productId, argument / 100.0)) status = WireStatus::NotFound;
+            break;
+        case WireOp::Value:
+            value = llround(manager.getTotalStockValue() * 100);
+            break;
+        default:
+            status = WireStatus::BadRequest;
+            break;
+        }
+        char response[wireResponseSize] = {};
+        storeLittle(response, tag, 4);
+        response[4] = static_cast<char>(op);
+        response[5] = static_cast<char>(status);
+        storeLittle(response + 8, static_cast<uint64_t>(value), 8);
+        out.append(response, sizeof(response));
+    }
+
+    // Answer every complete frame buffered on a connection; false on a malformed frame
+    bool processInput(Connection& connection) {
+        const string& in = connection.input;
+        size_t at = connection.inputStart;
+        uint64_t count = 0;
+        while (in.size() - at >= wireRequestSize) {
+            const char* frame = in.data() + at;
+            const size_t payloadLength = static_cast<unsigned char>(frame[2]) | static_cast<size_t>(static_cast<unsigned char>(frame[3])) << 8;
+            if (payloadLength > wireMaxPayload) return false;
+            if (in.size() - at < wireRequestSize + payloadLength) break; // Rest of the frame is still in flight
+            execute(static_cast<WireOp>(frame[0]), loadLittle32(frame + 4), loadLittle32(frame + 8),
+                static_cast<int32_t>(loadLittle32(frame + 12)), string_view(frame + wireRequestSize, payloadLength), connection.output);
+            at += wireRequestSize + payloadLength;
+            ++count;
+        }
+        served.fetch_add(count, memory_order_relaxed);
+        // Keep only the unparsed tail, so the buffer stays small and is reused
+        if (at == in.size()) {
+            connection.input.clear();
+            at = 0;
+        }
+        else if (at >= readChunk) {
+            connection.input.erase(0, at);
+            at = 0;
+        }
+        connection.inputStart = at;
+        return true;
+    }
+
+    void eventLoop() {
+        SocketPoller poller;
+        unordered_map<SocketHandle, Connection> connections;
+        vector<SocketPoller::Event> events;
+        vector<char> chunk(readChunk);
+        poller.add(listener);
+
+        auto drop = [&](SocketHandle socket) {
+            poller.remove(socket);
+            closeSocket(socket);
+            connections.erase(socket);
+        };
+
+        // Send what the socket takes, then watch for writability only while a
+        // backlog remains and for requests only while it is under the limit
+        auto flush = [&](SocketHandle socket, Connection& connection) {
+            while (connection.outputStart < connection.output.size()) {
+                long long sent = sendSome(socket, connection.output.data() + connection.outputStart,
+                    connection.output.size() - connection.outputStart);
+                if (sent < 0) {
+                    if (!socketWouldBlock()) return false;
+                    break;
+                }
+                connection.outputStart += static_cast<size_t>(sent);
+            }
+            if (connection.outputStart == connection.output.size()) {
+                connection.output.clear(); // Keeps its capacity for the next batch
+                connection.outputStart = 0;
+            }
+            const bool wantWrite = !connection.output.empty();
+            const bool wantRead = connection.output.size() < outputLimit;
+            if (wantWrite != connection.wantWrite || wantRead != connection.wantRead) {
+                connection.wantWrite = wantWrite;
+                connection.wantRead = wantRead;
+                poller.update(socket, wantRead, wantWrite);
+            }
+            return true;
+        };
+
+        while (!stopping.load(memory_order_acquire)) {
+            poller.wait(100, events);
+            for (const SocketPoller::Event& event : events) {
+                if (event.socket == listener) {
+                    for (SocketHandle client = accept(listener, nullptr, nullptr); client != invalidSocket;
+                        client = accept(listener, nullptr, nullptr)) {
+                        int noDelay = 1;
+                        setsockopt(client, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+                        if (!setNonBlocking(client) || !poller.add(client)) {
+                            closeSocket(client);
+                            continue;
+                        }
+                        connections[client];
+                    }
+                    continue;
+                }
+                auto found = connections.find(event.socket);
+                if (found == connections.end()) continue;
+                Connection& connection = found->second;
+                bool alive = true;
+                if (event.writable) alive = flush(event.socket, connection);
+                if (alive && (event.readable || event.failed) && connection.wantRead) {
+                    while (alive && connection.output.size() < outputLimit) {
+                        long long received = receiveSome(event.socket, chunk.data(), chunk.size());
+                        if (received == 0) alive = false; // Orderly shutdown by the client
+                        else if (received < 0) {
+                            alive = socketWouldBlock();
+                            break;
+                        }
+                        else {
+                            connection.input.append(chunk.data(), static_cast<size_t>(received));
+                            alive = processInput(connection);
+                            if (static_cast<size_t>(received) < chunk.size()) break; // Drained the socket
+                        }
+                    }
+                    if (alive) alive = flush(event.socket, connection);
+                }
+                if (!alive) drop(event.socket);
+            }
+        }
+        for (auto& entry : connections) closeSocket(entry.first);
+    }
+
+public:
+    explicit InventoryServer(InventoryManager& inventory, bool answerReadsOnly = false)
+        : manager(inventory), readOnly(answerReadsOnly) {}
+
+    InventoryServer(const InventoryServer&) = delete;
+    InventoryServer& operator=(const InventoryServer&) = delete;
+
+    ~InventoryServer() { stop(); }
+
+    // Listen on `port` (0 picks a free one; see port()) on all interfaces, or
+    // loopback only, and start `threads` event loops. Returns false with a
+    // message if the socket could not be set up.
+    bool start(uint16_t port, unsigned threads, bool loopbackOnly = false) {
+        if (!startSockets()) {
+            cout << "Could not initialize sockets.\n";
+            return false;
+        }
+        listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (listener == invalidSocket) {
+            cout << "Could not create a socket.\n";
+            return false;
+        }
+        int reuse = 1;
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        address.sin_addr.s_addr = htonl(loopbackOnly ? INADDR_LOOPBACK : INADDR_ANY);
+        socklen_t length = sizeof(address);
+        if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, SOMAXCONN) != 0
+            || !setNonBlocking(listener) || getsockname(listener, reinterpret_cast<sockaddr*>(&address), &length) != 0) {
+            cout << "Could not listen on port " << port << ".\n";
+            closeSocket(listener);
+            listener = invalidSocket;
+            return false;
+        }
+        boundPort = ntohs(address.sin_port);
+        for (unsigned i = 0; i < max(1u, threads); ++i) loops.emplace_back(&InventoryServer::eventLoop, this);
+        return true;
+    }
+
+    // Close every connection and stop the event loops
+    void stop() {
+        if (stopping.exchange(true, memory_order_acq_rel)) return;
+        for (thread& loop : loops) loop.join();
+        if (listener != invalidSocket) closeSocket(listener);
+        listener = invalidSocket;
+    }
+
+    uint16_t port() const { return boundPort; }
+    uint64_t getRequestsServed() const { return served.load(memory_order_relaxed); }
+};
+
+/*
+ * Log shipping between a primary and its read replicas.
+ * A replica opens a TCP connection and sends a hello: "INVREPL1" plus the
+ * last WAL sequence it has applied (0 for a fresh replica). The primary
+ * answers with messages of a ReplicationHeader and a body:
+ *   Snapshot  - a checkpoint image; the header sequence is the WAL position it covers
+ *   Records   - raw WAL records in sequence order, exactly as written to disk
+ *   Heartbeat - empty, sent when nothing was shipped for a second
+ * Every header also carries the primary's newest flushed sequence and its
+ * clock, which is what the replica measures its lag against.
+ */
+enum class ReplicationMessage : uint8_t { Snapshot = 1, Records = 2, Heartbeat = 3 };
+
+const char replicationMagic[8] = { 'I', 'N', 'V', 'R', 'E', 'P', 'L', '1' };
+const size_t replicationHelloSize = 16;
+const size_t replicationHeaderSize = 32; // u8 type, 3 reserved, u32 body length, u64 sequence, u64 primary sequence, i64 primary epoch ns
+const uint32_t replicationMaxBody = 1u << 30;
+
+inline uint64_t loadLittle64(const char* bytes) {
+    return loadLittle32(bytes) | static_cast<uint64_t>(loadLittle32(bytes + 4)) << 32;
+}
+
+/*
+ * Primary side of log shipping.
+ * Every batch the WAL writer flushes is kept in a bounded in-memory history
+ * (64 MB) that subscriber threads ship from, one thread per replica. A
+ * replica whose next record is still in the history gets the records from
+ * there; a fresh one, or one that fell behind the history, first gets a
+ * snapshot. Needs InventoryManager::enableDurableLog.
+ */
+class ReplicationPublisher {
+    struct Chunk {
+        uint64_t first;
+        uint64_t last;
+        shared_ptr<const string> frames;
+    };
+
+    struct Session {
+        SocketHandle socket;
+        thread worker;
+        atomic<bool> finished{ false };
+    };
+
+    static constexpr size_t historyLimit = 64 * 1024 * 1024;
+
+    InventoryManager& manager;
+    SocketHandle listener = invalidSocket;
+    uint16_t boundPort = 0;
+    atomic<bool> stopping{ false };
+    thread acceptor;
+
+    mutex historyMutex; // Guards everything below
+    condition_variable historyChanged;
+    deque<Chunk> history;
+    size_t historyBytes = 0;
+    uint64_t coveredFrom = 1;  // First sequence the history can still ship
+    uint64_t lastSequence = 0; // Newest sequence flushed by the primary
+    vector<unique_ptr<Session>> sessions;
+
+    // WAL flush observer: runs on the log writer thread, so it only copies
+    void publish(string_view frames, uint64_t last) {
+        if (frames.empty()) return;
+        auto copy = make_shared<const string>(frames);
+        {
+            lock_guard<mutex> lock(historyMutex);
+            if (last <= lastSequence) return;
+            history.push_back(Chunk{ lastSequence + 1, last, move(copy) });
+            historyBytes += frames.size();
+            lastSequence = last;
+            while (historyBytes > historyLimit && history.size() > 1) {
+                historyBytes -= history.front().frames->size();
+                coveredFrom = history.front().last + 1;
+                history.pop_front();
+            }
+        }
+        replicationGauges.sequence.store(last, memory_order_relaxed);
+        historyChanged.notify_all();
+    }
+
+    static bool sendMessage(SocketHandle socket, ReplicationMessage type, uint64_t sequence, uint64_t primarySequence, string_view body) {
+        char header[replicationHeaderSize] = {};
+        header[0] = static_cast<char>(type);
+        storeLittle(header + 4, body.size(), 4);
+        storeLittle(header + 8, sequence, 8);
+        storeLittle(header + 16, primarySequence, 8);
+        storeLittle(header + 24, static_cast<uint64_t>(TimestampClock::now().epochNs), 8);
+        return sendAll(socket, header, sizeof(header)) && sendAll(socket, body.data(), body.size());
+    }
+
+    // One replica connection, on its own thread
+    void serve(SocketHandle socket) {
+        char hello[replicationHelloSize];
+        if (!receiveAll(socket, hello, sizeof(hello)) || memcmp(hello, replicationMagic, sizeof(replicationMagic)) != 0) return;
+        uint64_t next = loadLittle64(hello + 8) + 1; // First record the replica needs
+
+        bool needSnapshot;
+        {
+            lock_guard<mutex> lock(historyMutex);
+            needSnapshot = next == 1 || next < coveredFrom || next > lastSequence + 1;
+        }
+        if (needSnapshot) {
+            // Built outside historyMutex: the snapshot takes the catalog lock
+            uint64_t through = 0;
+            string image = manager.buildReplicaSnapshot(through);
+            uint64_t newest;
+            {
+                lock_guard<mutex> lock(historyMutex);
+                newest = lastSequence;
+            }
+            if (!sendMessage(socket, ReplicationMessage::Snapshot, through, max(newest, through), image)) return;
+            next = through + 1;
+        }
+
+        vector<Chunk> pending;
+        while (!stopping.load(memory_order_acquire)) {
+            uint64_t newest;
+            pending.clear();
+            {
+                unique_lock<mutex> lock(historyMutex);
+                historyChanged.wait_for(lock, chrono::seconds(1), [&] {
+                    return stopping.load(memory_order_acquire) || lastSequence >= next;
+                });
+                if (stopping.load(memory_order_acquire)) return;
+                if (next < coveredFrom) return; // Fell behind the history; it resyncs on reconnect
+                for (const Chunk& chunk : history) {
+                    if (chunk.last >= next) pending.push_back(chunk);
+                }
+                newest = lastSequence;
+            }
+            if (pending.empty()) {
+                if (!sendMessage(socket, ReplicationMessage::Heartbeat, next - 1, newest, string_view())) return;
+                continue;
+            }
+            for (const Chunk& chunk : pending) {
+                // A chunk may start before `next`; the replica skips what it already has
+                if (!sendMessage(socket, ReplicationMessage::Records, chunk.last, newest, *chunk.frames)) return;
+                next = chunk.last + 1;
+            }
+        }
+    }
+
+    void acceptLoop() {
+        SocketPoller poller;
+        poller.add(listener);
+        vector<SocketPoller::Event> events;
+        while (!stopping.load(memory_order_acquire)) {
+            poller.wait(200, events);
+            for (SocketHandle client = accept(listener, nullptr, nullptr); client != invalidSocket;
+                client = accept(listener, nullptr, nullptr)) {
+                // Accepted sockets may inherit non-blocking mode; sessions use blocking I/O
+                setNonBlocking(client, false);
+                int noDelay = 1;
+                setsockopt(client, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+                auto session = make_unique<Session>();
+                session->socket = client;
+                Session* raw = session.get();
+                lock_guard<mutex> lock(historyMutex);
+                if (stopping.load(memory_order_acquire)) {
+                    closeSocket(client);
+                    break;
+                }
+                session->worker = thread([this, raw] {
+                    replicationGauges.subscribers.fetch_add(1, memory_order_relaxed);
+                    serve(raw->socket);
+                    replicationGauges.subscribers.fetch_sub(1, memory_order_relaxed);
+                    raw->finished.store(true, memory_order_release);
+                });
+                sessions.push_back(move(session));
+            }
+            // Reap replicas that disconnected
+            lock_guard<mutex> lock(historyMutex);
+            for (size_t i = 0; i < sessions.size();) {
+                if (sessions[i]->finished.load(memory_order_acquire)) {
+                    sessions[i]->worker.join();
+                    closeSocket(sessions[i]->socket);
+                    sessions[i] = move(sessions.back());
+                    sessions.pop_back();
+                }
+                else {
+                    ++i;
+                }
+            }
+        }
+    }
+
+public:
+    explicit ReplicationPublisher(InventoryManager& inventory) : manager(inventory) {}
+
+    ReplicationPublisher(const ReplicationPublisher&) = delete;
+    ReplicationPublisher& operator=(const ReplicationPublisher&) = delete;
+
+    ~ReplicationPublisher() { stop(); }
+
+    // Listen for replicas on `port` (0 picks a free one) and start shipping
+    // every WAL flush. Returns false with a message if the durable log is off
+    // or the socket could not be set up.
+    bool start(uint16_t port) {
+        if (!manager.durableLogEnabled()) {
+            cout << "Replication needs the durable log.\n";
+            return false;
+        }
+        if (!startSockets()) {
+            cout << "Could not initialize sockets.\n";
+            return false;
+        }
+        listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (listener == invalidSocket) {
+            cout << "Could not create a socket.\n";
+            return false;
+        }
+        int reuse = 1;
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        address.sin_addr.s_addr = htonl(INADDR_ANY);
+        socklen_t length = sizeof(address);
+        if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, SOMAXCONN) != 0
+            || !setNonBlocking(listener) || getsockname(listener, reinterpret_cast<sockaddr*>(&address), &length) != 0) {
+            cout << "Could not listen for replicas on port " << port << ".\n";
+            closeSocket(listener);
+            listener = invalidSocket;
+            return false;
+        }
+        boundPort = ntohs(address.sin_port);
+
+        // Install the observer first: every change after this sequence is seen by publish()
+        manager.setWalFlushObserver([this](string_view frames, uint64_t last) { publish(frames, last); });
+        uint64_t since = manager.getLoggedSequence();
+        {
+            lock_guard<mutex> lock(historyMutex);
+            if (history.empty()) {
+                coveredFrom = since + 1;
+                lastSequence = since;
+            }
+        }
+        replicationGauges.role.store(ReplicationGauges::Primary, memory_order_relaxed);
+        replicationGauges.sequence.store(since, memory_order_relaxed);
+        acceptor = thread(&ReplicationPublisher::acceptLoop, this);
+        return true;
+    }
+
+    // Disconnect every replica and stop shipping
+    void stop() {
+        if (stopping.exchange(true, memory_order_acq_rel)) return;
+        if (listener == invalidSocket) return;
+        manager.setWalFlushObserver({});
+        historyChanged.notify_all();
+        acceptor.join();
+        for (auto& session : sessions) shutdownSocket(session->socket); // Wakes a blocked send
+        for (auto& session : sessions) {
+            session->worker.join();
+            closeSocket(session->socket);
+        }
+        sessions.clear();
+        closeSocket(listener);
+        listener = invalidSocket;
+    }
+
+    uint16_t port() const { return boundPort; }
+};
+
 /*
- * Abstract base class representing a generic product.
- * Provides common attributes and methods for all product types.
+ * Replica side of log shipping.
+ * A background thread connects to the primary, loads the bootstrap snapshot
+ * into the (empty) catalog and then applies shipped WAL records in sequence
+ * order. After a dropped connection or a gap it reconnects once a second and
+ * resumes from the last applied record; if the primary no longer has the
+ * records it needs, the primary sends a fresh snapshot and the replica
+ * replaces its catalog with it. Reads on the replica see the
+ * primary's state as of that record; the replica itself takes no writes.
  */
-class Product {
-protected:
-    string productName;
-    double price;
-    int stockQuantity;
-
+class ReplicaSubscriber {
 public:
-    // Constructor to initialize product details
-    Product(string name, double pr, int stock) : productName(name), price(pr), stockQuantity(stock) {}
+    struct Status {
+        bool connected = false;
+        uint64_t appliedSequence = 0;
+        uint64_t primarySequence = 0;
+        uint64_t lagRecords = 0;
+        double lagSeconds = 0.0;     // Age of the newest applied change while behind, 0 when caught up
+    };
+
+private:
+    InventoryManager& manager;
+    string host;
+    uint16_t port;
+    thread worker;
+    atomic<bool> stopping{ false };
+    atomic<bool> connected{ false };
 
-    // Display basic product information
-    virtual void displayProduct() const {
-        cout << "Product Name: " << productName
-            << ", Price: $" << price
-            << ", Stock Quantity: " << stockQuantity << endl;
+    mutex stateMutex; // Guards everything below
+    condition_variable wake;
+    SocketHandle active = invalidSocket;
+    uint64_t applied = 0;
+    uint64_t primarySequence = 0;
+    int64_t lastStampNs = 0; // Primary timestamp of the newest applied change
+    int64_t lagNs = 0;
+
+    // Recompute the lag gauges after a message sent at `primaryNowNs`
+    void updateLag(uint64_t newest, int64_t primaryNowNs) {
+        lock_guard<mutex> lock(stateMutex);
+        primarySequence = max(primarySequence, newest);
+        bool behind = primarySequence > applied;
+        lagNs = behind ? max<int64_t>(0, primaryNowNs - lastStampNs) : 0;
+        replicationGauges.sequence.store(applied, memory_order_relaxed);
+        replicationGauges.lagRecords.store(behind ? primarySequence - applied : 0, memory_order_relaxed);
+        replicationGauges.lagMs.store(static_cast<uint64_t>(lagNs / 1000000), memory_order_relaxed);
     }
 
-    // Apply a percentage discount to the product price
-    virtual void applyDiscount(double percentage) {
-        price -= price * (percentage / 100);
+    // Follow the primary over one connection until it drops
+    void follow(SocketHandle socket) {
+        char hello[replicationHelloSize];
+        memcpy(hello, replicationMagic, sizeof(replicationMagic));
+        {
+            lock_guard<mutex> lock(stateMutex);
+            storeLittle(hello + 8, applied, 8);
+        }
+        if (!sendAll(socket, hello, sizeof(hello))) return;
+
+        char header[replicationHeaderSize];
+        string body;
+        while (!stopping.load(memory_order_acquire) && receiveAll(socket, header, sizeof(header))) {
+            ReplicationMessage type = static_cast<ReplicationMessage>(header[0]);
+            uint32_t length = loadLittle32(header + 4);
+            uint64_t sequence = loadLittle64(header + 8);
+            uint64_t newest = loadLittle64(header + 16);
+            int64_t primaryNowNs = static_cast<int64_t>(loadLittle64(header + 24));
+            if (length > replicationMaxBody) return;
+            body.resize(length);
+            if (!receiveAll(socket, body.data(), body.size())) return;
+
+            if (type == ReplicationMessage::Snapshot) {
+                uint64_t through = 0;
+                manager.loadReplicaSnapshot(body, through);
+                lock_guard<mutex> lock(stateMutex);
+                applied = through;
+                lastStampNs = primaryNowNs;
+            }
+            else if (type == ReplicationMessage::Records) {
+                uint64_t position;
+                int64_t stamp;
+                {
+                    lock_guard<mutex> lock(stateMutex);
+                    position = applied;
+                    stamp = lastStampNs;
+                }
+                bool inOrder = manager.applyReplicatedRecords(body, position, stamp);
+                {
+                    lock_guard<mutex> lock(stateMutex);
+                    applied = position;
+                    lastStampNs = stamp;
+                }
+                if (!inOrder || position < sequence) {
+                    cout << "Gap in the replication stream after record " << position << "; resyncing.\n";
+                    updateLag(newest, primaryNowNs);
+                    return;
+                }
+            }
+            else if (type != ReplicationMessage::Heartbeat) {
+                return;
+            }
+            updateLag(newest, primaryNowNs);
+        }
     }
 
-    // Pure virtual function to identify the product type (must be overridden by derived classes)
-    virtual string getProductType() const = 0;
+    void run() {
+        bool reported = false; // Only say once per outage that the primary is gone
+        while (!stopping.load(memory_order_acquire)) {
+            SocketHandle socket = connectTo(host, port);
+            if (socket != invalidSocket) {
+                {
+                    lock_guard<mutex> lock(stateMutex);
+                    if (stopping.load(memory_order_acquire)) {
+                        closeSocket(socket);
+                        break;
+                    }
+                    active = socket;
+                }
+                connected.store(true, memory_order_release);
+                reported = false;
+                follow(socket);
+                connected.store(false, memory_order_release);
+                lock_guard<mutex> lock(stateMutex);
+                closeSocket(active);
+                active = invalidSocket;
+            }
+            if (!reported && !stopping.load(memory_order_acquire)) {
+                cout << "No connection to the primary at " << host << ":" << port << "; retrying.\n";
+                reported = true;
+            }
+            unique_lock<mutex> lock(stateMutex);
+            wake.wait_for(lock, chrono::seconds(1), [this] { return stopping.load(memory_order_acquire); });
+        }
+    }
 
-    // Modify stock by a given quantity (can be positive or negative)
-    void updateStock(int quantity) {
-        stockQuantity += quantity;
+public:
+    ReplicaSubscriber(InventoryManager& inventory, string primaryHost, uint16_t primaryPort)
+        : manager(inventory), host(move(primaryHost)), port(primaryPort) {}
+
+    ReplicaSubscriber(const ReplicaSubscriber&) = delete;
+    ReplicaSubscriber& operator=(const ReplicaSubscriber&) = delete;
+
+    ~ReplicaSubscriber() { stop(); }
+
+    // Start following the primary; the catalog must be empty
+    bool start() {
+        if (!startSockets()) {
+            cout << "Could not initialize sockets.\n";
+            return false;
+        }
+        if (manager.getProductCount() != 0) {
+            cout << "A replica must start with an empty catalog.\n";
+            return false;
+        }
+        replicationGauges.role.store(ReplicationGauges::Replica, memory_order_relaxed);
+        worker = thread(&ReplicaSubscriber::run, this);
+        return true;
     }
 
-    // Attempt to sell a product if sufficient stock is available
-    bool sellProduct(int quantity) {
-        if (stockQuantity >= quantity) {
-            stockQuantity -= quantity;
-            return true;
+    // Disconnect and stop applying changes
+    void stop() {
+        if (stopping.exchange(true, memory_order_acq_rel)) return;
+        {
+            lock_guard<mutex> lock(stateMutex);
+            if (active != invalidSocket) shutdownSocket(active); // Wakes a blocked receive
         }
-        return false;
+        wake.notify_all();
+        if (worker.joinable()) worker.join();
     }
 
-    // Accessor methods for product information
-    int getStockQuantity() const { return stockQuantity; }
-    string getProductName() const { return productName; }
+    Status getStatus() {
+        Status status;
+        status.connected = connected.load(memory_order_acquire);
+        lock_guard<mutex> lock(stateMutex);
+        status.appliedSequence = applied;
+        status.primarySequence = primarySequence;
+        status.lagRecords = primarySequence > applied ? primarySequence - applied : 0;
+        status.lagSeconds = lagNs / 1e9;
+        return status;
+    }
 };
 
-// Electronics product with additional warranty info
-class Electronics : public Product {
+// Process-wide heap allocation counter for the benchmark suite. Counting is
+// off unless a benchmark turns it on, so normal runs only pay a relaxed load.
+atomic<bool> allocationCountingEnabled{ false };
+atomic<uint64_t> allocationCount{ 0 };
+
+void* operator new(size_t size) {
+    if (allocationCountingEnabled.load(memory_order_relaxed)) allocationCount.fetch_add(1, memory_order_relaxed);
+    if (void* block = malloc(size ? size : 1)) return block;
+    throw bad_alloc();
+}
+
+// GCC flags malloc/free inside replaced operators once they are inlined into callers
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void* block) noexcept { free(block); }
+void operator delete(void* block, size_t) noexcept { free(block); }
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+// Settings for the synthetic workload run by --bench-workload
+struct WorkloadConfig {
+    size_t skuCount = 100000;
+    double foodShare = 0.33;       // Fraction of the catalog that is Food
+    size_t minNameLength = 8;      // Names are padded to a length drawn uniformly from this range
+    size_t maxNameLength = 32;
+    size_t operations = 1000000;   // Operations in the mixed phase
+    double zipfExponent = 0.99;    // Skew of sale popularity (0 = uniform)
+    size_t restockEvery = 10000;   // Run checkAndRestock after this many operations
+    size_t discountEvery = 100000; // Run a bulk discount after this many operations
+    size_t saveLoadCycles = 3;
+    uint32_t seed = 42;
+};
+
+// Draws ranks 0..n-1 with probability proportional to 1 / (rank + 1)^s
+class ZipfSampler {
 private:
-    int warrantyPeriod; // Warranty period in months
+    vector<double> cdf;
+    uniform_real_distribution<double> unit{ 0.0, 1.0 };
 
 public:
-    // Constructor to initialize electronics product
-    Electronics(string name, double pr, int stock, int warranty)
-        : Product(name, pr, stock), warrantyPeriod(warranty) {}
-
-    // Display product details along with warranty information
-    void displayProduct() const override {
-        Product::displayProduct();
-        cout << "Warranty Period: " << warrantyPeriod << " months" << endl;
+    ZipfSampler(size_t n, double exponent) : cdf(n) {
+        double total = 0.0;
+        for (size_t rank = 0; rank < n; ++rank) {
+            total += 1.0 / pow(static_cast<double>(rank + 1), exponent);
+            cdf[rank] = total;
+        }
+        for (double& value : cdf) value /= total;
     }
 
-    // Return the product type as a string (override of the base class method)
-    string getProductType() const override {
-        return "Electronics";
+    template <typename Rng>
+    size_t operator()(Rng& rng) {
+        size_t rank = lower_bound(cdf.begin(), cdf.end(), unit(rng)) - cdf.begin();
+        return min(rank, cdf.size() - 1);
     }
 };
 
-// Food product with expiration date info
-class Food : public Product {
-private:
-    string expirationDate; // Expiration date of the food product
+// Per-operation latency samples and allocation totals for one benchmark row
+struct LatencySeries {
+    string name;
+    vector<uint64_t> samplesNs;
+    uint64_t allocations = 0;
 
-public:
-    // Constructor to initialize food product
-    Food(string name, double pr, int stock, string expiration)
-        : Product(name, pr, stock), expirationDate(expiration) {}
+    explicit LatencySeries(string label) : name(move(label)) {}
 
-    // Display product details along with expiration information
-    void displayProduct() const override {
-        Product::displayProduct();
-        cout << "Expiration Date: " << expirationDate << endl;
+    // Time one call of fn and count the allocations it made
+    template <typename Fn>
+    void measure(Fn&& fn) {
+        uint64_t allocsBefore = allocationCount.load(memory_order_relaxed);
+        int64_t start = TimestampClock::monotonicNs();
+        fn();
+        samplesNs.push_back(static_cast<uint64_t>(TimestampClock::monotonicNs() - start));
+        allocations += allocationCount.load(memory_order_relaxed) - allocsBefore;
     }
 
-    // Return the product type as a string (override of the base class method)
-    string getProductType() const override {
-        return "Food";
+    // Print count, throughput, latency percentiles and allocations per operation
+    void report() {
+        if (samplesNs.empty()) return;
+        sort(samplesNs.begin(), samplesNs.end());
+        uint64_t totalNs = 0;
+        for (uint64_t sample : samplesNs) totalNs += sample;
+        auto percentile = [this](double p) {
+            return samplesNs[min(samplesNs.size() - 1, static_cast<size_t>(p * samplesNs.size()))];
+        };
+        cout << left << setw(15) << name << right
+            << setw(10) << samplesNs.size()
+            << setw(13) << static_cast<uint64_t>(samplesNs.size() / (max<uint64_t>(totalNs, 1) / 1e9))
+            << setw(11) << percentile(0.50) << setw(11) << percentile(0.99)
+            << setw(11) << percentile(0.999) << setw(12) << samplesNs.back()
+            << setw(11) << fixed << setprecision(2) << static_cast<double>(allocations) / samplesNs.size() << "\n";
+        cout.unsetf(ios::fixed);
     }
 };
 
-// Manages inventory of products
-class InventoryManager {
-private:
-    map<string, shared_ptr<Product>> inventory; // Map of product names to product pointers
-    const int restockAmount = 10; // Amount to restock low inventory items
+// Drive InventoryManager with a synthetic catalog and a realistic operation mix:
+// Zipf-skewed sales by name, periodic restock passes and bulk discounts, then
+// save/load cycles. Console output from the manager is suppressed while it runs.
+void runWorkloadBenchmark(const WorkloadConfig& config) {
+    const char* logFile = "bench_transaction_log.txt";
+    const char* loadLogFile = "bench_load_log.txt";
+    const char* saveFile = "bench_inventory.txt";
+    mt19937_64 rng(config.seed);
 
-public:
-    // Add a product to the inventory (if it doesn't already exist)
-    void addProduct(shared_ptr<Product> product) {
-        string name = product->getProductName();
-        if (inventory.find(name) != inventory.end()) {
-            cout << "Product with name '" << name << "' already exists. Skipping...\n";
-            return;
-        }
-        inventory[name] = product;
+    // Synthetic names: a unique prefix padded with letters to a random length
+    vector<string> names(config.skuCount);
+    uniform_int_distribution<size_t> nameLength(config.minNameLength, max(config.minNameLength, config.maxNameLength));
+    for (size_t i = 0; i < names.size(); ++i) {
+        names[i] = "SKU" + to_string(i) + "-";
+        size_t length = nameLength(rng);
+        while (names[i].size() < length) names[i] += static_cast<char>('a' + rng() % 26);
     }
+    // Popularity ranks map to shuffled SKUs so hot items are spread through the catalog
+    vector<uint32_t> skuByRank(config.skuCount);
+    for (uint32_t i = 0; i < skuByRank.size(); ++i) skuByRank[i] = i;
+    shuffle(skuByRank.begin(), skuByRank.end(), rng);
+    ZipfSampler popularity(config.skuCount, config.zipfExponent);
 
-    // Display all products in the inventory
-    void displayInventory() const {
-        if (inventory.empty()) {
-            cout << "Inventory is empty.\n";
-            return;
-        }
-        for (const auto& pair : inventory) {
-            pair.second->displayProduct();
+    LatencySeries add("add"), sale("sale"), restock("restock pass"), discount("bulk discount"),
+        drain("log drain"), save("save"), load("load");
+    sale.samplesNs.reserve(config.operations);
+    add.samplesNs.reserve(config.skuCount);
+
+    struct NullBuffer : streambuf {
+        int overflow(int c) override { return c; }
+    } nullBuffer;
+    streambuf* console = cout.rdbuf(&nullBuffer);
+    allocationCountingEnabled.store(true, memory_order_relaxed);
+    auto wallStart = chrono::steady_clock::now();
+    {
+        InventoryManager manager(logFile);
+        manager.reserveProducts(config.skuCount);
+        uniform_real_distribution<double> unit(0.0, 1.0);
+        for (const string& name : names) {
+            double price = 1.0 + static_cast<double>(rng() % 50000) / 100;
+            int stock = static_cast<int>(rng() % 100);
+            if (unit(rng) < config.foodShare) {
+                string expiration = "2026-" + string(rng() % 2 ? "11" : "12") + "-1" + to_string(rng() % 10);
+                add.measure([&] { manager.addProduct(Food(name, price, stock, expiration)); });
+            }
+            else {
+                add.measure([&] { manager.addProduct(Electronics(name, price, stock, 12)); });
+            }
         }
-    }
 
-    // Sell a product by name and log the transaction
-    bool sellProduct(const string& productName, int quantity) {
-        auto it = inventory.find(productName);
-        if (it != inventory.end()) {
-            bool success = it->second->sellProduct(quantity);
-            if (success) {
-                logTransaction("Sale", productName, quantity); // Log successful sale
+        for (size_t op = 1; op <= config.operations; ++op) {
+            const string& name = names[skuByRank[popularity(rng)]];
+            sale.measure([&] { manager.sellProduct(name, 1); });
+            if (config.restockEvery && op % config.restockEvery == 0) {
+                restock.measure([&] { manager.checkAndRestock(5); });
+            }
+            if (config.discountEvery && op % config.discountEvery == 0) {
+                discount.measure([&] { manager.applyBulkDiscount(op / config.discountEvery % 2 ? ProductTypeTag::Food : ProductTypeTag::Electronics, 1.0); });
             }
-            return success;
         }
-        return false; // Return false if product is not found or insufficient stock
+        drain.measure([&] { manager.flushLog(); });
+
+        for (size_t cycle = 0; cycle < config.saveLoadCycles; ++cycle) {
+            save.measure([&] { manager.saveInventoryToFile(saveFile); });
+            load.measure([&] {
+                InventoryManager reloaded(loadLogFile);
+                reloaded.loadInventoryFromFile(saveFile);
+            });
+        }
     }
+    double wallSeconds = chrono::duration<double>(chrono::steady_clock::now() - wallStart).count();
+    allocationCountingEnabled.store(false, memory_order_relaxed);
+    cout.rdbuf(console);
+    remove(logFile);
+    remove(loadLogFile);
+    remove(saveFile);
+    for (uint64_t number : listDeltaSegments(saveFile)) remove(deltaSegmentPath(saveFile, number).c_str());
 
-    // Apply a discount to a product by name and log the transaction
-    void applyDiscount(const string& productName, double percentage) {
-        auto it = inventory.find(productName);
-        if (it != inventory.end()) {
-            it->second->applyDiscount(percentage);
-            logTransaction("Discount", productName, percentage); // Log discount application
+    cout << "Workload: " << config.skuCount << " SKUs (" << config.foodShare * 100 << "% Food, names "
+        << config.minNameLength << "-" << config.maxNameLength << " chars), " << config.operations
+        << " operations, Zipf s=" << config.zipfExponent << ", " << wallSeconds << " s total\n";
+    cout << left << setw(15) << "operation" << right << setw(10) << "count" << setw(13) << "ops/s"
+        << setw(11) << "p50 ns" << setw(11) << "p99 ns" << setw(11) << "p999 ns" << setw(12) << "max ns"
+        << setw(11) << "allocs/op" << "\n";
+    for (LatencySeries* series : { &add, &sale, &restock, &discount, &drain, &save, &load }) series->report();
+}
+
+// Benchmark ProductIndex against the std::map it replaced for a given catalog size.
+// Reports build time and average lookup time over a shuffled probe order.
+void runIndexBenchmark(size_t skuCount) {
+    vector<string> names;
+    names.reserve(skuCount);
+    for (size_t i = 0; i < skuCount; ++i) {
+        names.push_back("SKU-" + to_string(i * 2654435761u % 1000000007u));
+    }
+    vector<uint32_t> probes(skuCount);
+    for (uint32_t i = 0; i < probes.size(); ++i) probes[i] = i;
+    shuffle(probes.begin(), probes.end(), mt19937(42));
+
+    using Clock = chrono::steady_clock;
+    auto elapsedMs = [](Clock::time_point start) {
+        return chrono::duration<double, milli>(Clock::now() - start).count();
+    };
+
+    uint64_t checksum = 0;
+    double mapBuild, mapLookup, indexBuild, indexLookup;
+    {
+        auto start = Clock::now();
+        map<string, uint32_t> tree;
+        for (uint32_t i = 0; i < names.size(); ++i) tree.emplace(names[i], i);
+        mapBuild = elapsedMs(start);
+        start = Clock::now();
+        for (uint32_t probe : probes) checksum += tree.find(names[probe])->second;
+        mapLookup = elapsedMs(start);
+    }
+    {
+        auto start = Clock::now();
+        CatalogArena arena;
+        ProductIndex index(arena);
+        for (const string& name : names) index.insert(name);
+        indexBuild = elapsedMs(start);
+        start = Clock::now();
+        for (uint32_t probe : probes) checksum += index.find(names[probe]);
+        indexLookup = elapsedMs(start);
+    }
+
+    cout << fixed << setprecision(1)
+        << setw(10) << skuCount << " SKUs | map build " << setw(9) << mapBuild << " ms, lookup "
+        << setw(7) << mapLookup * 1e6 / skuCount << " ns | index build " << setw(9) << indexBuild
+        << " ms, lookup " << setw(7) << indexLookup * 1e6 / skuCount << " ns"
+        << "  (checksum " << checksum << ")\n";
+    cout.unsetf(ios::fixed);
+}
+
+// Benchmark tag dispatch against the virtual hierarchy it replaced, on the two
+// bulk paths that visit every product: a per-type scan and a text-save pass.
+void runDispatchBenchmark(size_t skuCount) {
+    // The previous shape: a vtable per object and a new string per type query
+    struct VirtualProduct {
+        string name;
+        double price;
+        int stock;
+        VirtualProduct(string n, double p, int s) : name(move(n)), price(p), stock(s) {}
+        virtual ~VirtualProduct() = default;
+        virtual string getProductType() const = 0;
+        virtual void appendDetail(string& out) const = 0;
+    };
+    struct VirtualElectronics : VirtualProduct {
+        int warranty;
+        VirtualElectronics(string n, double p, int s, int w) : VirtualProduct(move(n), p, s), warranty(w) {}
+        string getProductType() const override { return "Electronics"; }
+        void appendDetail(string& out) const override { out += to_string(warranty); }
+    };
+    struct VirtualFood : VirtualProduct {
+        string expiration;
+        VirtualFood(string n, double p, int s, string e) : VirtualProduct(move(n), p, s), expiration(move(e)) {}
+        string getProductType() const override { return "Food"; }
+        void appendDetail(string& out) const override { out += expiration; }
+    };
+
+    vector<unique_ptr<VirtualProduct>> virtualProducts;
+    virtualProducts.reserve(skuCount);
+    CatalogArena arena;
+    ProductStore store;
+    store.reserve(skuCount);
+    vector<Product*> taggedProducts;
+    taggedProducts.reserve(skuCount);
+    for (size_t i = 0; i < skuCount; ++i) {
+        string name = "SKU-" + to_string(i * 2654435761u % 1000000007u);
+        double price = 1.0 + i % 500;
+        int stock = static_cast<int>(i % 50);
+        uint32_t id;
+        if (i % 3 == 0) {
+            virtualProducts.push_back(make_unique<VirtualFood>(name, price, stock, "2026-01-15"));
+            id = store.append(ProductTypeTag::Food, arena.intern(name), price, stock, 0, arena.intern("2026-01-15"));
+            taggedProducts.push_back(arena.create<Food>(&store, id));
         }
         else {
-            cout << "Product not found.\n";
+            virtualProducts.push_back(make_unique<VirtualElectronics>(name, price, stock, 12));
+            id = store.append(ProductTypeTag::Electronics, arena.intern(name), price, stock, 12, string_view());
+            taggedProducts.push_back(arena.create<Electronics>(&store, id));
         }
     }
 
-    // Save the inventory state to a file (used for persistent storage)
-    void saveInventoryToFile() const {
-        ofstream outFile("inventory.txt");
-        for (const auto& pair : inventory) {
-            outFile << pair.first << " | "
-                << pair.second->getProductType() << " | "
-                << pair.second->getStockQuantity() << " | " << endl;
+    using Clock = chrono::steady_clock;
+    auto nsPerItem = [skuCount](Clock::time_point start) {
+        return chrono::duration<double, nano>(Clock::now() - start).count() / skuCount;
+    };
+    char number[32];
+    double checksum = 0;
+    double virtualScan, taggedScan, virtualSave, taggedSave;
+    {
+        auto start = Clock::now();
+        double value = 0;
+        for (const auto& product : virtualProducts) {
+            if (product->getProductType() == "Electronics") value += product->price * product->stock;
         }
-        outFile.close();
+        virtualScan = nsPerItem(start);
+        checksum += value;
     }
-
-    // Placeholder function for future inventory loading (not yet implemented)
-    void loadInventoryFromFile() {
-        ifstream inFile("inventory.txt");
-        string line;
-        while (getline(inFile, line)) {
-            // Parse and recreate objects (to be implemented in the future)
+    {
+        auto start = Clock::now();
+        double value = 0;
+        for (const Product* product : taggedProducts) {
+            if (product->getTypeTag() == ProductTypeTag::Electronics) value += product->getPrice() * product->getStockQuantity();
+        }
+        taggedScan = nsPerItem(start);
+        checksum += value;
+    }
+    {
+        auto start = Clock::now();
+        string buffer;
+        buffer.reserve(skuCount * 48);
+        for (const auto& product : virtualProducts) {
+            buffer += product->name;
+            buffer += " | " + product->getProductType() + " | ";
+            buffer += to_string(product->stock);
+            buffer += " | ";
+            buffer.append(number, to_chars(number, number + sizeof(number), product->price).ptr);
+            buffer += " | ";
+            product->appendDetail(buffer);
+            buffer += " | \n";
+        }
+        virtualSave = nsPerItem(start);
+        checksum += buffer.size();
+    }
+    {
+        auto start = Clock::now();
+        string buffer;
+        buffer.reserve(skuCount * 48);
+        for (const Product* product : taggedProducts) {
+            buffer += product->getProductName();
+            buffer += " | ";
+            buffer += product->getProductType();
+            buffer += " | ";
+            buffer += to_string(product->getStockQuantity());
+            buffer += " | ";
+            buffer.append(number, to_chars(number, number + sizeof(number), product->getPrice()).ptr);
+            buffer += " | ";
+            visitProduct(*product, [&](const auto& concrete) { concrete.appendRecordFields(buffer); });
+            buffer += '\n';
         }
+        taggedSave = nsPerItem(start);
+        checksum += buffer.size();
     }
 
-    // Check the inventory for low stock items and restock them if necessary
-    void checkAndRestock(int threshold) {
-        for (const auto& pair : inventory) {
-            if (pair.second->getStockQuantity() < threshold) {
-                restockProduct(pair.second);
+    cout << fixed << setprecision(1)
+        << setw(10) << skuCount << " SKUs | scan: virtual " << setw(6) << virtualScan << " ns, tagged " << setw(6) << taggedScan
+        << " ns | save: virtual " << setw(6) << virtualSave << " ns, tagged " << setw(6) << taggedSave << " ns per item"
+        << "  (checksum " << checksum << ")\n";
+    cout.unsetf(ios::fixed);
+}
+
+// Loopback benchmark for the network service: `connections` client threads
+// each keep two packets of `batch` pipelined sell requests in flight against
+// an in-process server, and the sustained request rate is reported.
+bool runServerBenchmark(unsigned connections, size_t batch) {
+    const uint32_t productCount = 100000;
+    const size_t packetsPerClient = 2000;
+    InventoryManager manager("bench_server_log.txt");
+    manager.reserveProducts(productCount);
+    for (uint32_t i = 0; i < productCount; ++i) {
+        manager.addProduct(ProductTypeTag::Electronics, "SKU" + to_string(i), 10.0, 1000000000, 12, "");
+    }
+    InventoryServer server(manager);
+    if (!server.start(0, parallelWorkerCount(), true)) return false;
+
+    atomic<uint64_t> accepted{ 0 };
+    atomic<bool> failed{ false };
+    auto client = [&](unsigned seed) {
+        SocketHandle socket = connectTo("127.0.0.1", server.port());
+        if (socket == invalidSocket) {
+            failed.store(true);
+            return;
+        }
+
+        // The packet is serialized once and resent as is
+        mt19937 rng(seed);
+        string packet;
+        for (size_t i = 0; i < batch; ++i) appendWireRequest(packet, WireOp::Sell, static_cast<uint32_t>(i), rng() % productCount, 1);
+        vector<char> responses(batch * wireResponseSize);
+        auto sendPacket = [&] { return sendAll(socket, packet.data(), packet.size()); };
+        auto receivePacket = [&] {
+            if (!receiveAll(socket, responses.data(), responses.size())) return false;
+            for (size_t i = 0; i < batch; ++i) {
+                if (responses[i * wireResponseSize + 5] == static_cast<char>(WireStatus::Ok)) accepted.fetch_add(1, memory_order_relaxed);
             }
+            return true;
+        };
+        bool ok = sendPacket();
+        for (size_t packetNumber = 1; ok && packetNumber < packetsPerClient; ++packetNumber) ok = sendPacket() && receivePacket();
+        ok = ok && receivePacket();
+        if (!ok) failed.store(true);
+        closeSocket(socket);
+    };
+
+    auto start = chrono::steady_clock::now();
+    vector<thread> clients;
+    for (unsigned i = 0; i < connections; ++i) clients.emplace_back(client, i + 1);
+    for (thread& t : clients) t.join();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    server.stop();
+    manager.flushLog();
+
+    const uint64_t requests = uint64_t(connections) * packetsPerClient * batch;
+    cout << connections << " connections x " << batch << " pipelined sells: " << requests << " requests in " << seconds << " s ("
+        << static_cast<uint64_t>(requests / seconds) << " requests/s), " << accepted.load() << " accepted"
+        << (failed.load() ? " -> FAIL\n" : " -> PASS\n");
+    return !failed.load() && accepted.load() == requests;
+}
+
+// Stress test for concurrent checkout: many threads sell (or reserve and then
+// commit, release or abandon) random products until stock runs out, then the
+// final stock is checked against the units sold.
+// Returns false if any product oversold or went negative.
+bool runConcurrentSellStress(unsigned threadCount) {
+    const uint32_t productCount = 1000;
+    const int initialStock = 500;
+    const char* logFile = "stress_transaction_log.txt";
+    bool passed = true;
+    {
+        InventoryManager manager(logFile);
+        for (uint32_t i = 0; i < productCount; ++i) {
+            manager.addProduct(Electronics("Stress-" + to_string(i), 10.0, initialStock, 12));
+        }
+
+        atomic<uint64_t> unitsSold{ 0 };
+        atomic<uint64_t> attempts{ 0 };
+        auto start = chrono::steady_clock::now();
+        vector<thread> registers;
+        for (unsigned t = 0; t < threadCount; ++t) {
+            registers.emplace_back([&, t] {
+                mt19937 rng(t + 1);
+                uint64_t sold = 0, tried = 0;
+                for (int i = 0; i < 400000; ++i) {
+                    uint32_t id = rng() % productCount;
+                    int quantity = 1 + static_cast<int>(rng() % 3);
+                    ++tried;
+                    if (i % 4 != 0) {
+                        if (manager.sellProductById(id, quantity)) sold += quantity;
+                        continue;
+                    }
+                    // Two-phase checkout: reserve, then commit, release, or abandon to expire
+                    ReservationTable::Handle handle = manager.reserveStock(id, quantity, chrono::milliseconds(1));
+                    if (!handle.valid()) continue;
+                    unsigned outcome = rng() % 3;
+                    if (outcome == 0 && manager.commitReservation(handle)) sold += quantity;
+                    else if (outcome == 1) manager.releaseReservation(handle);
+                }
+                unitsSold += sold;
+                attempts += tried;
+            });
+        }
+        for (thread& worker : registers) worker.join();
+        this_thread::sleep_for(chrono::milliseconds(2));
+        manager.reclaimExpiredReservations();
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        uint64_t remaining = 0;
+        for (uint32_t id = 0; id < productCount; ++id) {
+            int stock = manager.getStockQuantity(id);
+            if (stock < 0) passed = false;
+            remaining += static_cast<uint64_t>(max(stock, 0));
         }
+        if (remaining + unitsSold != uint64_t(productCount) * initialStock) passed = false;
+        if (manager.getOutstandingReservations() != 0) passed = false;
+
+        cout << threadCount << " threads: " << attempts << " sell attempts in " << seconds << " s ("
+            << static_cast<uint64_t>(attempts / seconds) << " ops/s), " << unitsSold << " units sold, "
+            << remaining << " left -> " << (passed ? "PASS" : "FAIL") << "\n";
     }
+    remove(logFile);
+    return passed;
+}
 
-    // Restock a product by a set amount and log the transaction
-    void restockProduct(shared_ptr<Product> product) {
-        product->updateStock(restockAmount);
-        logTransaction("Restock", product->getProductName(), restockAmount);
-        cout << "Restocked " << product->getProductName() << " by " << restockAmount << " units.\n";
+// Display the inventory pageSize products at a time (0 shows everything),
+// asking before each further page
+void displayInventoryPaged(const InventoryManager& manager, const DisplayOptions& options, size_t pageSize) {
+    // Sort and filter once; later pages are slices of the same selection
+    const vector<uint32_t> ids = manager.selectInventory(options);
+    const size_t limit = pageSize ? pageSize : SIZE_MAX;
+    size_t offset = 0;
+    while (true) {
+        manager.displayProducts(ids, offset, limit);
+        if (pageSize == 0 || offset + pageSize >= ids.size()) break;
+        offset += pageSize;
+        cout << "Showing " << offset << " of " << ids.size() << " products.\n";
+        if (getYesOrNoInput("Show more? (yes/no): ") == "no") break;
+    }
+}
+
+// Print the running totals per product type and the number of products below `threshold`
+void printInventorySummary(const InventoryManager& manager, int threshold, ostream& out = cout) {
+    StockAggregates::Summary summary = manager.getInventorySummary();
+    for (ProductTypeTag type : ProductTypes::tags) {
+        const StockAggregates::TypeTotals& totals = summary.byType[static_cast<uint8_t>(type)];
+        out << productTypeName(type) << ": " << totals.products << " products, "
+            << totals.units << " units, value $" << totals.value << "\n";
     }
+    out << "Out of stock: " << summary.countBelow(1) << ", below " << threshold << " units: " << summary.countBelow(threshold) << "\n";
+}
 
-    // Log transaction involving quantity change (integer-based) with timestamp
-    void logTransaction(const string& type, const string& productName, int quantity) const {
-        ofstream logFile("transaction_log.txt", ios::app);
-        std::time_t now = std::time(nullptr);
-        std::tm localTime;
-        localtime_s(&localTime, &now);  // Thread-safe localtime_s function
-        logFile << std::put_time(&localTime, "%Y-%m-%d %H:%M:%S")  // Format timestamp
-            << " " << type << " - " << productName << " | Quantity: " << quantity << endl;
-        logFile.close();
+// Print the `k` fastest-selling products with their recent sales rate
+void printHotProducts(InventoryManager& manager, size_t k, ostream& out = cout) {
+    vector<InventoryManager::HotProduct> hot = manager.getHotProducts(k);
+    if (hot.empty()) out << "No recent sales.\n";
+    const ios::fmtflags flags = out.flags();
+    const streamsize precision = out.precision();
+    out << fixed << setprecision(1);
+    for (size_t i = 0; i < hot.size(); ++i) {
+        out << i + 1 << ". " << manager.getProductName(hot[i].id) << ": " << hot[i].unitsPerDay << " units/day\n";
     }
+    out.flags(flags);
+    out.precision(precision);
+}
 
-    // Log transaction involving discount percentage with timestamp
-    void logTransaction(const string& type, const string& productName, double percentage) const {
-        ofstream logFile("transaction_log.txt", ios::app);
-        std::time_t now = std::time(nullptr);
-        std::tm localTime;
-        localtime_s(&localTime, &now);  // Thread-safe localtime_s function
-        logFile << std::put_time(&localTime, "%Y-%m-%d %H:%M:%S")  // Format timestamp
-            << " " << type << " - " << productName << " | Discount: " << percentage << "%" << endl;
-        logFile.close();
+// Turn the name the operator typed into a product id. An exact name is used
+// as is, a single prefix or close-spelling match is used with a note, and
+// several matches are offered as a numbered list.
+// Returns ProductIndex::npos if nothing matched or the operator cancelled.
+uint32_t chooseProduct(const InventoryManager& manager, const string& typed) {
+    vector<uint32_t> candidates = manager.resolveProductName(typed);
+    if (candidates.empty()) return ProductIndex::npos;
+    if (candidates.size() == 1) {
+        string_view name = manager.getProductName(candidates[0]);
+        if (name != typed) cout << "Using '" << name << "'.\n";
+        return candidates[0];
+    }
+    cout << "Several products match '" << typed << "':\n";
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        cout << "  " << i + 1 << ". " << manager.getProductName(candidates[i]) << "\n";
+    }
+    int choice = getValidatedInt("Choose a product (0 to cancel): ", 0);
+    if (choice == 0 || static_cast<size_t>(choice) > candidates.size()) return ProductIndex::npos;
+    return candidates[choice - 1];
+}
+
+// Parse "type=Food", "below=5", "prefix=Lap", "offset=100" or "limit=20" into options
+bool parseDisplayOption(string_view field, DisplayOptions& options) {
+    size_t eq = field.find('=');
+    if (eq == string_view::npos) return false;
+    string_view key = field.substr(0, eq);
+    string_view value = field.substr(eq + 1);
+    int number = 0;
+    if (key == "type") {
+        options.filterByType = true;
+        return ProductTypes::parse(value, options.type);
+    }
+    if (key == "prefix") {
+        options.prefix = string(value);
+        return true;
     }
+    if (!parseIntField(value, number) || number < 0) return false;
+    if (key == "below") options.stockBelow = number;
+    else if (key == "offset") options.offset = static_cast<size_t>(number);
+    else if (key == "limit") options.limit = static_cast<size_t>(number);
+    else return false;
+    return true;
+}
+
+// Parse a reorder rule name as used by the script policy command
+inline bool parseReorderRule(string_view text, ReorderRule& rule) {
+    if (text == "fixed") rule = ReorderRule::Fixed;
+    else if (text == "minmax") rule = ReorderRule::MinMax;
+    else if (text == "demand") rule = ReorderRule::Demand;
+    else if (text == "none") rule = ReorderRule::None;
+    else return false;
+    return true;
+}
+
+// Summary counters for a script run
+struct ScriptSummary {
+    size_t commands = 0;
+    size_t added = 0, duplicates = 0;
+    size_t sales = 0, failedSales = 0;
+    size_t discounts = 0, unknownDiscounts = 0;
+    size_t restockPasses = 0, saves = 0;
+    size_t replenished = 0, unknownPolicies = 0;
+    vector<size_t> malformedLines;
 };
 
-// Helper function to get and validate integer input from the user
-int getValidatedInt(const string& prompt, int minValue = INT_MIN) {
-    int value;
-    while (true) {
-        cout << prompt;
-        cin >> value;
-        if (cin.fail() || value < minValue) {
-            cin.clear();
-            cin.ignore(numeric_limits<streamsize>::max(), '\n');
-            cout << "Invalid input. Please try again.\n";
+// Run a script of " | "-delimited commands, one per line ('#' starts a comment):
+//   add | Name | Electronics | Stock | Price | Warranty
+//   add | Name | Food | Stock | Price | YYYY-MM-DD
+//   add | Name | Apparel | Stock | Price | Size
+//   add | Name | Pharmacy | Stock | Price | DosageMg | YYYY-MM-DD
+//   sell | Name | Quantity
+//   discount | Name | Percentage
+//   restock | Threshold
+//   policy | Name | fixed|minmax|demand|none | ReorderPoint | Quantity [| CoverDays]
+//   replenish
+//   save
+//   list [| type=Food] [| below=5] [| prefix=Lap] [| offset=N] [| limit=N]
+//   summary [| Threshold]
+//   hot [| K]
+//   metrics
+// The add fields follow the inventory.txt layout. Messages from the manager
+// are suppressed (list, summary and metrics output still goes to the
+// console), and a run summary is printed at the end. Returns the process exit
+// code: 1 if any line was malformed.
+int runScript(InventoryManager& manager, string_view script, bool useBinarySnapshot) {
+    ScriptSummary summary;
+    struct NullBuffer : streambuf {
+        int overflow(int c) override { return c; }
+    } nullBuffer;
+    streambuf* console = cout.rdbuf(&nullBuffer);
+    ostream consoleOut(console);
+    auto start = chrono::steady_clock::now();
+
+    size_t lineNumber = 0;
+    while (!script.empty()) {
+        size_t eol = script.find('\n');
+        string_view line = trimField(script.substr(0, eol));
+        script.remove_prefix(eol == string_view::npos ? script.size() : eol + 1);
+        ++lineNumber;
+        if (line.empty() || line.front() == '#') continue;
+
+        string_view fields[8];
+        size_t count = splitRecordFields(line, fields, 8);
+        string_view command = fields[0];
+        bool ok = false;
+        ++summary.commands;
+        if (command == "add" && count >= 4) {
+            int stock = 0, integer = 0;
+            double price = 0.0;
+            string_view text;
+            ProductTypeTag type = ProductTypeTag::Electronics;
+            ok = !fields[1].empty() && fields[1].size() <= maxStoredStringLength && ProductTypes::parse(fields[2], type)
+                && parseIntField(fields[3], stock) && stock >= 0
+                && (count < 5 || (parseDoubleField(fields[4], price) && price >= 0))
+                && (count < 6 || parseProductFields(type, fields + 5, count - 5, integer, text));
+            if (ok) {
+                if (manager.addProduct(type, fields[1], price, stock, integer, text)) {
+                    ++summary.added;
+                }
+                else {
+                    ++summary.duplicates;
+                }
+            }
         }
-        else {
-            cin.ignore();
-            return value;
+        else if (command == "sell" && count == 3) {
+            int quantity = 0;
+            ok = parseIntField(fields[2], quantity) && quantity > 0;
+            if (ok && manager.sellProduct(fields[1], quantity)) ++summary.sales;
+            else if (ok) ++summary.failedSales;
+        }
+        else if (command == "discount" && count == 3) {
+            double percentage = 0.0;
+            ok = parseDoubleField(fields[2], percentage) && percentage >= 0 && percentage <= 100;
+            if (ok && manager.applyDiscountById(manager.findProductId(fields[1]), percentage)) ++summary.discounts;
+            else if (ok) ++summary.unknownDiscounts;
+        }
+        else if (command == "restock" && count == 2) {
+            int threshold = 0;
+            ok = parseIntField(fields[1], threshold);
+            if (ok) {
+                manager.checkAndRestock(threshold);
+                ++summary.restockPasses;
+            }
+        }
+        else if (command == "policy" && count >= 5) {
+            ReplenishmentPolicy policy;
+            uint32_t id = manager.findProductId(fields[1]);
+            ok = parseReorderRule(fields[2], policy.rule)
+                && parseIntField(fields[3], policy.reorderPoint) && policy.reorderPoint >= 0
+                && parseIntField(fields[4], policy.quantity) && policy.quantity >= 0
+                && (count < 6 || (parseDoubleField(fields[5], policy.coverDays) && policy.coverDays >= 0));
+            if (ok && !manager.setReplenishmentPolicy(id, policy)) ++summary.unknownPolicies;
+        }
+        else if (command == "replenish" && count == 1) {
+            ok = true;
+            summary.replenished += manager.replenish();
+        }
+        else if (command == "list") {
+            DisplayOptions options;
+            ok = true;
+            for (size_t i = 1; i < count && ok; ++i) ok = parseDisplayOption(fields[i], options);
+            if (ok) manager.displayInventory(options, consoleOut);
+        }
+        else if (command == "summary" && count <= 2) {
+            int threshold = 10;
+            ok = count == 1 || parseIntField(fields[1], threshold);
+            if (ok) printInventorySummary(manager, threshold, consoleOut);
+        }
+        else if (command == "hot" && count <= 2) {
+            int k = 10;
+            ok = (count == 1 || parseIntField(fields[1], k)) && k > 0;
+            if (ok) printHotProducts(manager, static_cast<size_t>(k), consoleOut);
         }
+        else if (command == "metrics" && count == 1) {
+            ok = true;
+            consoleOut << formatMetricsText(manager.getMetrics());
+        }
+        else if (command == "save" && count == 1) {
+            ok = true;
+            if (useBinarySnapshot) manager.saveInventorySnapshot();
+            else manager.saveInventoryToFile();
+            ++summary.saves;
+        }
+        if (!ok) {
+            --summary.commands;
+            summary.malformedLines.push_back(lineNumber);
+        }
+    }
+    manager.checkpoint();
+    manager.flushLog();
+    manager.writeMetricsFile();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout.rdbuf(console);
+
+    cout << "Script finished: " << summary.commands << " commands in " << seconds << " s ("
+        << static_cast<uint64_t>(summary.commands / max(seconds, 1e-9)) << " commands/s)\n"
+        << "  added " << summary.added << " (" << summary.duplicates << " duplicates skipped)\n"
+        << "  sold " << summary.sales << " (" << summary.failedSales << " failed: unknown product or insufficient stock)\n"
+        << "  discounted " << summary.discounts << " (" << summary.unknownDiscounts << " unknown products)\n"
+        << "  restock passes " << summary.restockPasses << ", saves " << summary.saves << "\n"
+        << "  replenished " << summary.replenished << " (" << summary.unknownPolicies << " policies for unknown products)\n";
+    if (!summary.malformedLines.empty()) {
+        cout << "  " << summary.malformedLines.size() << " malformed lines skipped, on lines";
+        for (size_t i = 0; i < min<size_t>(summary.malformedLines.size(), 10); ++i) cout << " " << summary.malformedLines[i];
+        cout << "\n";
+        return 1;
     }
+    return 0;
 }
 
-// Helper function to get and validate double input from the user
-double getValidatedDouble(const string& prompt, double minValue = -DBL_MAX) {
-    double value;
-    while (true) {
-        cout << prompt;
-        cin >> value;
-        if (cin.fail() || value < minValue) {
-            cin.clear();
-            cin.ignore(numeric_limits<streamsize>::max(), '\n');
-            cout << "Invalid input. Please try again.\n";
-        }
-        else {
-            cin.ignore();
-            return value;
+// Print where a replica stands relative to its primary
+void printReplicationStatus(ReplicaSubscriber& replica, ostream& out = cout) {
+    ReplicaSubscriber::Status status = replica.getStatus();
+    ios::fmtflags flags = out.flags();
+    streamsize precision = out.precision();
+    out << "Replication: " << (status.connected ? "connected" : "disconnected")
+        << ", applied record " << status.appliedSequence << " of " << status.primarySequence
+        << ", lag " << status.lagRecords << " records / " << fixed << setprecision(3) << status.lagSeconds << " s\n";
+    out.flags(flags);
+    out.precision(precision);
+}
+
+// Run as a read-only replica of the primary at `primary` (HOST:PORT): follow
+// its log and answer reads from the console menu, or from the network with
+// --serve. The replica keeps no checkpoint or write-ahead log of its own.
+int runReplica(InventoryManager& manager, const string& primary, int servePort, size_t pageSize, bool writeMetrics) {
+    size_t colon = primary.rfind(':');
+    int port = colon == string::npos ? 0 : atoi(primary.c_str() + colon + 1);
+    if (colon == string::npos || colon == 0 || port <= 0 || port > 65535) {
+        cout << "Expected --replica-of HOST:PORT, got '" << primary << "'.\n";
+        return 1;
+    }
+    ReplicaSubscriber replica(manager, primary.substr(0, colon), static_cast<uint16_t>(port));
+    if (!replica.start()) return 1;
+    cout << "Replicating from " << primary << ".\n";
+
+    // The only background job on a replica: every other one would change the catalog
+    InventoryManager::MaintenanceSchedule maintenance;
+    maintenance.reservationSweep = chrono::milliseconds::zero();
+    maintenance.replenishment = chrono::milliseconds::zero();
+    if (writeMetrics) maintenance.metricsReport = chrono::seconds(10);
+    manager.startMaintenance(maintenance);
+
+    string input;
+    if (servePort >= 0) {
+        InventoryServer server(manager, true);
+        if (!server.start(static_cast<uint16_t>(servePort), parallelWorkerCount())) return 1;
+        cout << "Serving reads on port " << server.port() << ". Press Enter to stop.\n";
+        getline(cin, input);
+        server.stop();
+        cout << "Served " << server.getRequestsServed() << " requests.\n";
+    }
+    else {
+        while (true) {
+            cout << "\n=== Replica Menu ===\n"
+                << "1. Display Inventory\n"
+                << "2. Replication Status\n"
+                << "3. Exit\n"
+                << "Choose an option: ";
+
+            int option = getValidatedInt("", 1);
+            if (option == 1) {
+                displayInventoryPaged(manager, DisplayOptions(), pageSize);
+                cout << "Total stock value: $" << manager.getTotalStockValue() << "\n";
+                printInventorySummary(manager, 10);
+            }
+            else if (option == 2) {
+                printReplicationStatus(replica);
+            }
+            else if (option == 3) {
+                break;
+            }
+            else {
+                cout << "Invalid option. Please try again.\n";
+            }
         }
     }
+    replica.stop();
+    manager.stopMaintenance();
+    if (writeMetrics) manager.writeMetricsFile();
+    return 0;
 }
 
-// Helper function to get "yes" or "no" input from user
-string getYesOrNoInput(const string& prompt) {
+// Parse a non-negative whole-number option value. Unlike stoul, rejects
+// signs and trailing characters; throws invalid_argument or out_of_range.
+size_t parseCount(const string& value) {
+    if (value.empty() || !isdigit(static_cast<unsigned char>(value.front()))) throw invalid_argument(value);
+    size_t used = 0;
+    unsigned long long count = stoull(value, &used);
+    if (used != value.size()) throw invalid_argument(value);
+    if (count > SIZE_MAX) throw out_of_range(value);
+    return static_cast<size_t>(count);
+}
+
+// Parse a TCP port option value (0 picks a free port); throws like parseCount
+// and out_of_range above 65535
+int parsePort(const string& value) {
+    size_t port = parseCount(value);
+    if (port > 65535) throw out_of_range(value);
+    return static_cast<int>(port);
+}
+
+// Print the command-line options
+void printUsage() {
+    cout << "Usage: inventory_manager [--binary] [--script [FILE]] [--page-size N] [--no-sale-listing]\n"
+        << "    [--metrics FILE] [--threads N] [--autosave SECONDS] [--auto-restock THRESHOLD] [--expiry-sweep]\n"
+        << "    [--reorder-point N] [--serve PORT] [--replication-port PORT] [--replica-of HOST:PORT]\n"
+        << "    [--stress [THREADS]] [--bench-server [CONNECTIONS]] [--bench-index [MAX_SKUS]]\n"
+        << "    [--bench-dispatch [MAX_SKUS]] [--bench-workload [KEY=VALUE ...]]\n";
+}
+
+int main(int argc, char* argv[]) {
+    InventoryManager manager;  // Create an instance of the InventoryManager class to handle product operations
     string input;
-    while (true) {
-        cout << prompt;
-        getline(cin, input);
-        transform(input.begin(), input.end(), input.begin(), ::tolower);
 
-        if (input == "yes" || input == "no") {
-            return input;
+    // "--binary" persists the catalog as a binary snapshot (inventory.bin) instead of inventory.txt
+    bool useBinarySnapshot = false;
+    // "--script [file]" runs commands from a file (or stdin) instead of the menus
+    bool scriptMode = false;
+    string scriptPath = "-";
+    // "--page-size N" pages inventory listings (0 = no paging); "--no-sale-listing" skips the listing before a sale
+    size_t pageSize = 50;
+    bool showSaleListing = true;
+    // "--metrics FILE" keeps FILE updated with operation metrics in text exposition format
+    string metricsPath;
+    // "--threads N" sets the worker count for bulk loads, saves and background jobs (default: one per hardware thread)
+    // "--autosave SECONDS", "--auto-restock THRESHOLD" and "--expiry-sweep" add background jobs to the menu session
+    InventoryManager::MaintenanceSchedule maintenance;
+    // "--reorder-point N" gives every product a fixed policy: order 10 units once stock drops below N
+    int defaultReorderPoint = 0;
+    // "--serve PORT" answers the binary protocol on TCP (see InventoryServer) instead of showing the menus
+    int servePort = -1;
+    // "--replication-port PORT" ships the write-ahead log to read replicas;
+    // "--replica-of HOST:PORT" runs this process as one (see runReplica)
+    int replicationPort = -1;
+    string primaryAddress;
+
+    // An option's value is the next argument unless that is another "--" option
+    auto hasValue = [&](int i) { return i + 1 < argc && string_view(argv[i + 1]).rfind("--", 0) != 0; };
+    // Consume the value of an option that requires one
+    auto takeValue = [&](int& i) -> string {
+        if (!hasValue(i)) throw invalid_argument("missing value");
+        return argv[++i];
+    };
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        try {
+            if (arg == "--binary") useBinarySnapshot = true;
+            if (arg == "--no-sale-listing") showSaleListing = false;
+            if (arg == "--page-size") pageSize = parseCount(takeValue(i));
+            if (arg == "--metrics") metricsPath = takeValue(i);
+            if (arg == "--threads") parallelWorkers = static_cast<unsigned>(parseCount(takeValue(i)));
+            if (arg == "--autosave") maintenance.autosave = chrono::seconds(parseCount(takeValue(i)));
+            if (arg == "--expiry-sweep") maintenance.expirySweep = chrono::hours(1);
+            if (arg == "--reorder-point") defaultReorderPoint = stoi(takeValue(i));
+            if (arg == "--serve") servePort = parsePort(takeValue(i));
+            if (arg == "--replication-port") replicationPort = parsePort(takeValue(i));
+            if (arg == "--replica-of") primaryAddress = takeValue(i);
+            if (arg == "--auto-restock") {
+                maintenance.restockThreshold = stoi(takeValue(i));
+                maintenance.restockScan = chrono::minutes(1);
+            }
+
+            if (arg == "--script") {
+                scriptMode = true;
+                if (hasValue(i)) scriptPath = argv[++i];
+            }
+
+            // "--stress [threads]" hammers sellProductById from many threads and checks for overselling
+            if (arg == "--stress") {
+                unsigned threads = hasValue(i) ? static_cast<unsigned>(parseCount(argv[i + 1])) : max(2u, thread::hardware_concurrency());
+                return runConcurrentSellStress(threads) ? 0 : 1;
+            }
+
+            // "--bench-server [connections]" measures pipelined sells over loopback TCP and exits
+            if (arg == "--bench-server") {
+                unsigned connections = hasValue(i) ? static_cast<unsigned>(parseCount(argv[i + 1])) : 4;
+                return runServerBenchmark(connections, 256) ? 0 : 1;
+            }
+
+            // "--bench-index [maxSkus]" compares the hash index with std::map and exits
+            if (arg == "--bench-index") {
+                size_t maxSkus = hasValue(i) ? parseCount(argv[i + 1]) : 10000000;
+                for (size_t skus : { size_t(10000), size_t(1000000), size_t(10000000) }) {
+                    if (skus <= maxSkus) runIndexBenchmark(skus);
+                }
+                return 0;
+            }
+
+            // "--bench-workload [key=value ...]" runs the synthetic workload and exits
+            if (arg == "--bench-workload") {
+                WorkloadConfig config;
+                for (int j = i + 1; j < argc; ++j) {
+                    string option = argv[j];
+                    size_t eq = option.find('=');
+                    string key = option.substr(0, eq);
+                    string value = eq == string::npos ? "" : option.substr(eq + 1);
+                    if (value.empty()) {
+                        cout << "Expected key=value, got '" << option << "'.\n";
+                        return 1;
+                    }
+                    if (key == "skus") config.skuCount = max<size_t>(parseCount(value), 1);
+                    else if (key == "food") config.foodShare = stod(value);
+                    else if (key == "names") {
+                        size_t dash = value.find('-');
+                        config.minNameLength = parseCount(value.substr(0, dash));
+                        config.maxNameLength = dash == string::npos ? config.minNameLength : parseCount(value.substr(dash + 1));
+                    }
+                    else if (key == "ops") config.operations = parseCount(value);
+                    else if (key == "zipf") config.zipfExponent = stod(value);
+                    else if (key == "restock-every") config.restockEvery = parseCount(value);
+                    else if (key == "discount-every") config.discountEvery = parseCount(value);
+                    else if (key == "cycles") config.saveLoadCycles = parseCount(value);
+                    else if (key == "seed") config.seed = static_cast<uint32_t>(parseCount(value));
+                    else {
+                        cout << "Unknown workload option '" << key << "'.\n";
+                        return 1;
+                    }
+                }
+                runWorkloadBenchmark(config);
+                return 0;
+            }
+
+            // "--bench-dispatch [maxSkus]" compares tag dispatch with virtual calls and exits
+            if (arg == "--bench-dispatch") {
+                size_t maxSkus = hasValue(i) ? parseCount(argv[i + 1]) : 1000000;
+                for (size_t skus : { size_t(10000), size_t(100000), size_t(1000000) }) {
+                    if (skus <= maxSkus) runDispatchBenchmark(skus);
+                }
+                return 0;
+            }
         }
-        else {
-            cout << "Invalid input. Please enter 'yes' or 'no'.\n";
+        catch (const invalid_argument&) {
+            cout << "Invalid or missing value for " << arg << ".\n";
+            printUsage();
+            return 1;
+        }
+        catch (const out_of_range&) {
+            cout << "Value for " << arg << " is out of range.\n";
+            printUsage();
+            return 1;
         }
     }
-}
-// Helper function to validate dates 
-bool isValidDateFormat(const string& date) {
-    if (date.length() != 10 || date[4] != '-' || date[7] != '-') return false;
 
-    string yearStr = date.substr(0, 4);
-    string monthStr = date.substr(5, 2);
-    string dayStr = date.substr(8, 2);
+    string script;
+    if (scriptMode) {
+        if (scriptPath == "-") {
+            ostringstream buffer;
+            buffer << cin.rdbuf();
+            script = buffer.str();
+        }
+        else if (!readWholeFile(scriptPath, script)) {
+            cout << "Could not open script " << scriptPath << ".\n";
+            return 1;
+        }
+    }
+    else {
+        cout << "=== Inventory Management System ===\n";
+    }
 
-    try {
-        int year = stoi(yearStr);
-        int month = stoi(monthStr);
-        int day = stoi(dayStr);
+    if (!metricsPath.empty()) manager.setMetricsFile(metricsPath);
 
-        if (month < 1 || month > 12) return false;
-        if (day < 1 || day > 31) return false;
+    // A replica starts empty and takes its catalog from the primary, not from local files
+    if (!primaryAddress.empty()) return runReplica(manager, primaryAddress, servePort, pageSize, !metricsPath.empty());
 
-        // Optionally: add logic for months with only 30 days, leap years, etc.
-        return true;
+    // Recover from the last checkpoint and write-ahead log; on a fresh start fall
+    // back to the catalog saved by a previous session, if any
+    size_t loadedCount = manager.enableDurableLog();
+    if (loadedCount > 0) {
+        cout << "Recovered " << loadedCount << " products from inventory.checkpoint and inventory.wal.\n";
     }
-    catch (...) {
-        return false;
+    else {
+        loadedCount = useBinarySnapshot ? manager.loadInventorySnapshot() : manager.loadInventoryFromFile();
+        if (loadedCount > 0) {
+            cout << "Loaded " << loadedCount << " products from "
+                << (useBinarySnapshot ? "inventory.bin" : "inventory.txt") << ".\n";
+            manager.checkpoint();
+        }
     }
-}
 
-int main() {
-    InventoryManager manager;  // Create an instance of the InventoryManager class to handle product operations
-    string input;
+    if (defaultReorderPoint > 0) {
+        manager.setDefaultReplenishmentPolicy(ReplenishmentPolicy{ ReorderRule::Fixed, defaultReorderPoint, 10, 0.0 });
+    }
+
+    if (scriptMode) return runScript(manager, script, useBinarySnapshot);
+
+    // Sweeps, autosaves and reports run on the background scheduler, off the menu thread
+    maintenance.autosaveSnapshot = useBinarySnapshot;
+    if (!metricsPath.empty()) maintenance.metricsReport = chrono::seconds(10);
+    manager.startMaintenance(maintenance);
 
-    cout << "=== Inventory Management System ===\n";
+    ReplicationPublisher publisher(manager);
+    if (replicationPort >= 0) {
+        if (!publisher.start(static_cast<uint16_t>(replicationPort))) return 1;
+        cout << "Shipping the log to replicas on port " << publisher.port() << ".\n";
+    }
+
+    if (servePort >= 0) {
+        InventoryServer server(manager);
+        if (!server.start(static_cast<uint16_t>(servePort), parallelWorkerCount())) return 1;
+        cout << "Serving on port " << server.port() << ". Press Enter to stop.\n";
+        getline(cin, input);
+        server.stop();
+        cout << "Served " << server.getRequestsServed() << " requests.\n";
+        manager.checkpoint();
+        manager.flushLog();
+        manager.writeMetricsFile();
+        return 0;
+    }
 
     // =======================
     // Product Entry Loop
@@ -332,29 +6877,17 @@ int main() {
         // Get and validate stock quantity (must be non-negative)
         stock = getValidatedInt("Enter stock quantity: ", 0);
 
-        // Ask for product type (Electronics or Food)
-        cout << "Enter product type (Electronics or Food): ";
+        // Ask for the product type; any registered type name works, in any case
+        cout << "Enter product type (" << productTypeChoices() << "): ";
         getline(cin, type);
-        transform(type.begin(), type.end(), type.begin(), ::tolower);  // Normalize input
-
-        // Based on product type, gather additional details and create appropriate object
-        if (type == "electronics") {
-            int warranty = getValidatedInt("Enter warranty period (months): ", 0);
-            shared_ptr<Product> product = make_shared<Electronics>(name, price, stock, warranty);
-            manager.addProduct(product);  // Add to inventory
-        }
-        else if (type == "food") {
-            string expiration;
-
-            while (true) {
-                cout << "Enter expiration date (YYYY-MM-DD): ";
-                getline(cin, expiration);
-                if (isValidDateFormat(expiration)) break;
-                cout << "Invalid date format or value. Please try again.\n";
-            }
 
-            shared_ptr<Product> product = make_shared<Food>(name, price, stock, expiration);
-            manager.addProduct(product);  // Add to inventory
+        // Based on product type, gather the fields it declares and add the product
+        ProductTypeTag tag;
+        if (ProductTypes::parseIgnoringCase(type, tag)) {
+            int integer = 0;
+            string text;
+            promptProductFields(tag, integer, text);
+            manager.addProduct(tag, name, price, stock, integer, text);  // Add to inventory
         }
         else {
             cout << "Invalid product type. Skipping...\n";  // Skip invalid input
@@ -379,16 +6912,19 @@ int main() {
 
         // Handle user input based on selected menu option
         if (option == 1) {
-            // Show all products
-            manager.displayInventory();
+            // Show all products, a page at a time
+            displayInventoryPaged(manager, DisplayOptions(), pageSize);
+            cout << "Total stock value: $" << manager.getTotalStockValue() << "\n";
+            printInventorySummary(manager, 10);
         }
         else if (option == 2) {
 
-            // Display all products before selling
-            cout << "\n=== Inventory ===\n";
-            manager.displayInventory();
-
-            cout << "Please enter the *exact* product name as shown above.\n";
+            // Display all products before selling, unless disabled for large catalogs
+            if (showSaleListing) {
+                cout << "\n=== Inventory ===\n";
+                displayInventoryPaged(manager, DisplayOptions(), pageSize);
+            }
+            cout << "Enter the product name; a unique prefix or a close spelling also works.\n";
             cout << "You will then be asked to enter the quantity you'd like to sell.\n";
 
             // Sell a product
@@ -396,10 +6932,11 @@ int main() {
             int quantity;
             cout << "Enter product name to sell: ";
             getline(cin, name);
+            uint32_t id = chooseProduct(manager, name);
             quantity = getValidatedInt("Enter quantity to sell: ", 1);
 
             // Attempt sale and notify user of result
-            if (manager.sellProduct(name, quantity)) {
+            if (id != ProductIndex::npos && manager.sellProductById(id, quantity)) {
                 cout << "Sale successful!\n";
             }
             else {
@@ -412,10 +6949,15 @@ int main() {
             double percent;
             cout << "Enter product name for discount: ";
             getline(cin, name);
+            uint32_t id = chooseProduct(manager, name);
             percent = getValidatedDouble("Enter discount percentage: ", 0.0);
 
-            manager.applyDiscount(name, percent);
-            cout << "Discount applied.\n";
+            if (manager.applyDiscountById(id, percent)) {
+                cout << "Discount applied.\n";
+            }
+            else {
+                cout << "Product not found.\n";
+            }
         }
         else if (option == 4) {
             // Restock low inventory products
@@ -424,11 +6966,20 @@ int main() {
         }
         else if (option == 5) {
             // Save inventory state to a file
-            manager.saveInventoryToFile();
+            if (useBinarySnapshot) {
+                manager.saveInventorySnapshot();
+            }
+            else {
+                manager.saveInventoryToFile();
+            }
+            manager.flushLog();
             cout << "Inventory saved.\n";
         }
         else if (option == 6) {
             // Exit program
+            manager.checkpoint();
+            manager.flushLog();
+            manager.writeMetricsFile();
             cout << "Exiting program. Goodbye!\n";
             break;
         }